@@ -0,0 +1,188 @@
+import argparse
+import json
+import os
+import random
+import shutil
+import sqlite3
+import statistics
+import subprocess
+import tempfile
+import time
+import urllib.parse
+import urllib.request
+
+# Builds the same dump once per posting format and compares them: stored postings payload,
+# query latency, and how far the quantized rankings are from the exact one.
+#
+#   python3 bench/impact_bench.py --binary src/indexstream --dump raw_dump --queries queries.txt
+#
+# The dump directory is copied for every run (the server deletes what it ingests). Without
+# --queries, pairs of random dictionary terms from the exact build are used. --baseline runs
+# every mode again with an older binary on the same queries and reports the latency change,
+# end to end and for the scoring stage alone (scoring_ms of the search profile).
+
+MODES = [
+    ('exact', {'INDEXSTREAM_IMPACT_INDEX': '0'}),
+    ('impact', {'INDEXSTREAM_IMPACT_INDEX': '1', 'INDEXSTREAM_IMPACT_RESCORE': '0'}),
+    ('impact+rescore', {'INDEXSTREAM_IMPACT_INDEX': '1', 'INDEXSTREAM_IMPACT_RESCORE': '1'}),
+]
+
+
+def get_json(port, path):
+    with urllib.request.urlopen(f'http://127.0.0.1:{port}{path}', timeout=30) as response:
+        return json.loads(response.read())
+
+
+def wait_for_ingest(port, dump_dir, db_path, timeout):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        try:
+            get_json(port, '/api/status')
+            break
+        except OSError:
+            time.sleep(0.2)
+    # Ingested files are deleted; then wait for the document count to settle
+    previous = -1
+    while time.time() < deadline:
+        pending = [name for name in os.listdir(dump_dir) if not name.startswith('.')]
+        count = -1
+        if not pending and os.path.exists(db_path):
+            try:
+                with sqlite3.connect(db_path) as db:
+                    count = db.execute('SELECT COUNT(*) FROM documents').fetchone()[0]
+            except sqlite3.Error:
+                pass
+        if count >= 0 and count == previous:
+            return count
+        previous = count
+        time.sleep(2)
+    raise RuntimeError('ingest did not finish in time')
+
+
+def postings_payload(db_path):
+    with sqlite3.connect(db_path) as db:
+        return db.execute('SELECT COALESCE(SUM(LENGTH(data)), 0), COUNT(DISTINCT term_id) FROM posting_segments').fetchone()
+
+
+def sample_queries(db_path, count, seed):
+    with sqlite3.connect(db_path) as db:
+        terms = [row[0] for row in db.execute('SELECT term FROM terms WHERE document_count > 1')]
+    rng = random.Random(seed)
+    return [' '.join(rng.sample(terms, 2)) for _ in range(count)] if len(terms) >= 2 else []
+
+
+def run_mode(args, binary, name, env_overrides, port, queries):
+    work = tempfile.mkdtemp(prefix=f'impact_bench_{name}_')
+    dump_dir = os.path.join(work, 'raw_dump')
+    db_path = os.path.join(work, 'db', 'document_store.db')
+    shutil.copytree(args.dump, dump_dir)
+    os.makedirs(os.path.dirname(db_path))
+
+    env = dict(os.environ)
+    env.update({
+        'INDEXSTREAM_PORT': str(port),
+        'INDEXSTREAM_DB_PATH': db_path,
+        'INDEXSTREAM_DUMP_DIR': dump_dir,
+        'INDEXSTREAM_SEARCH_TOP_K': str(args.k),
+        'INDEXSTREAM_INGEST_LATENCY_MS': '500',
+    })
+    env.update(env_overrides)
+    server = subprocess.Popen([os.path.abspath(binary)], cwd=os.path.dirname(os.path.abspath(binary)), env=env,
+                              stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    try:
+        documents = wait_for_ingest(port, dump_dir, db_path, args.timeout)
+        payload, lists = postings_payload(db_path)
+        if queries is None:
+            queries = sample_queries(db_path, args.sample, args.seed)
+
+        rankings, latencies, scoring = {}, [], []
+        for query in queries:
+            path = '/api/search?profile=1&query=' + urllib.parse.quote(query)
+            for _ in range(args.repeat):
+                started = time.perf_counter()
+                body = get_json(port, path)
+                latencies.append((time.perf_counter() - started) * 1000)
+                scoring.append(body.get('profile', {}).get('scoring_ms', 0.0))
+            rankings[query] = [result['url'] for result in body.get('results', [])[:args.k]]
+        return {'documents': documents, 'payload': payload, 'lists': lists, 'latencies': latencies, 'scoring': scoring,
+                'rankings': rankings}, queries
+    finally:
+        server.terminate()
+        server.wait()
+        shutil.rmtree(work, ignore_errors=True)
+
+
+def percentiles(latencies):
+    latencies = sorted(latencies)
+    if not latencies:
+        return 0.0, 0.0
+    return statistics.median(latencies), latencies[int(len(latencies) * 0.95)]
+
+
+def compare(exact, other, k):
+    overlaps, top1, displacement = [], [], []
+    for query, reference in exact.items():
+        ranking = other.get(query, [])
+        if not reference:
+            continue
+        overlaps.append(len(set(reference[:k]) & set(ranking[:k])) / min(k, len(reference)))
+        top1.append(1.0 if ranking and ranking[0] == reference[0] else 0.0)
+        positions = {url: i for i, url in enumerate(ranking)}
+        displacement.append(statistics.mean(abs(i - positions.get(url, len(ranking))) for i, url in enumerate(reference[:k])))
+    if not overlaps:
+        return None
+    return statistics.mean(overlaps), statistics.mean(top1), statistics.mean(displacement)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare exact and impact-quantized posting lists')
+    parser.add_argument('--binary', required=True, help='indexstream server binary')
+    parser.add_argument('--dump', required=True, help='directory of dump files to index')
+    parser.add_argument('--queries', help='file with one query per line')
+    parser.add_argument('--sample', type=int, default=100, help='random queries when --queries is not given')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--repeat', type=int, default=3, help='timed runs per query')
+    parser.add_argument('--k', type=int, default=10, help='ranking depth compared')
+    parser.add_argument('--port', type=int, default=18080, help='first port; each mode uses the next one')
+    parser.add_argument('--timeout', type=int, default=600, help='seconds allowed for each build')
+    parser.add_argument('--baseline', help='older server binary to compare query latency against')
+    args = parser.parse_args()
+
+    queries = None
+    if args.queries:
+        with open(args.queries) as f:
+            queries = [line.strip() for line in f if line.strip()]
+
+    results = {}
+    for i, (name, env) in enumerate(MODES):
+        results[name], queries = run_mode(args, args.binary, name, env, args.port + i, queries)
+    baseline = {}
+    if args.baseline:
+        for i, (name, env) in enumerate(MODES):
+            baseline[name], _ = run_mode(args, args.baseline, name, env, args.port + len(MODES) + i, queries)
+
+    exact = results['exact']
+    print(f"{len(queries)} queries x {args.repeat}, {exact['documents']} documents, {exact['lists']} posting lists")
+    print(f"{'mode':<16}{'payload':>14}{'ratio':>8}{'p50 ms':>9}{'p95 ms':>9}{'overlap@' + str(args.k):>12}{'top-1':>8}{'displ.':>8}")
+    for name, result in results.items():
+        p50, p95 = percentiles(result['latencies'])
+        ratio = exact['payload'] / result['payload'] if result['payload'] else 0.0
+        ranking = compare(exact['rankings'], result['rankings'], args.k)
+        overlap, top1, displacement = ranking if ranking else (0.0, 0.0, 0.0)
+        print(f"{name:<16}{result['payload']:>14}{ratio:>7.2f}x{p50:>9.2f}{p95:>9.2f}{overlap:>12.3f}{top1:>8.3f}{displacement:>8.2f}")
+
+    if baseline:
+        print(f"\nlatency against {args.baseline}")
+        print(f"{'mode':<24}{'base p50':>10}{'p50':>9}{'change':>9}{'base p95':>10}{'p95':>9}{'change':>9}")
+        for name, result in results.items():
+            for stage in ('latencies', 'scoring'):
+                p50, p95 = percentiles(result[stage])
+                base_p50, base_p95 = percentiles(baseline[name][stage])
+                change50 = (p50 / base_p50 - 1) * 100 if base_p50 else 0.0
+                change95 = (p95 / base_p95 - 1) * 100 if base_p95 else 0.0
+                label = name if stage == 'latencies' else f'  {name} scoring'
+                print(f"{label:<24}{base_p50:>10.2f}{p50:>9.2f}{change50:>+8.1f}%{base_p95:>10.2f}{p95:>9.2f}{change95:>+8.1f}%")
+
+
+if __name__ == '__main__':
+    main()
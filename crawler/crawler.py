@@ -3,14 +3,34 @@ import requests
 from urllib.parse import urlparse, urljoin
 from bs4 import BeautifulSoup
 import os
+import struct
 import time
+import zlib
+
+# Packed dump segment record header, see src/dump_segment.hpp
+SEGMENT_MAGIC = b'ISEG'
+SEGMENT_FLAG_ZLIB = 0x01
+SEGMENT_FLAG_HEADER_CRC = 0x02
 
 class WebCrawler:
-    def __init__(self, user_agent='MyCrawler', delay=0.25, dump_dir='../raw_dump'):
+    def __init__(self, user_agent='MyCrawler', delay=0.25, dump_dir='../raw_dump', ingest_url=None, ingest_batch=32,
+                 segment_bytes=0, compress=True):
         self.user_agent = user_agent
         self.delay = delay
         self.visited_urls = set()
         self.dump_dir = dump_dir
+        # When set (e.g. http://localhost:8080/ingest) pages are posted to the server in
+        # batches instead of being written to dump_dir
+        self.ingest_url = ingest_url
+        self.ingest_batch = ingest_batch
+        self.pending = []
+        # When non-zero pages are appended to packed .seg files of about this size instead of
+        # one file per page
+        self.segment_bytes = segment_bytes
+        self.compress = compress
+        self.segment = None
+        self.segment_path = None
+        self.segment_count = 0
         os.makedirs(self.dump_dir, exist_ok=True)
 
     def is_allowed_to_crawl(self, url):
@@ -57,6 +77,65 @@ class WebCrawler:
             file.write(f"{url}\n---URL---\n{content}")
         print(f"Saved: {file_path}")
 
+    def append_segment(self, url, content):
+        if self.segment is None:
+            self.segment_path = os.path.join(self.dump_dir, f"crawl-{os.getpid()}-{time.time_ns()}-{self.segment_count}.seg")
+            self.segment = open(self.segment_path + '.tmp', 'wb')
+            self.segment_count += 1
+
+        url_bytes = url.encode('utf-8')
+        raw = content.encode('utf-8')
+        stored, flags = raw, SEGMENT_FLAG_HEADER_CRC
+        if self.compress:
+            packed = zlib.compress(raw, 6)
+            if len(packed) < len(raw):
+                stored, flags = packed, flags | SEGMENT_FLAG_ZLIB
+        header = struct.pack('<4sB3xIII', SEGMENT_MAGIC, flags, len(url_bytes), len(stored), len(raw))
+        crc = zlib.crc32(stored, zlib.crc32(url_bytes, zlib.crc32(header)))
+        self.segment.write(header + struct.pack('<I', crc))
+        self.segment.write(url_bytes)
+        self.segment.write(stored)
+
+        if self.segment.tell() >= self.segment_bytes:
+            self.close_segment()
+
+    def close_segment(self):
+        if self.segment is None:
+            return
+        self.segment.close()
+        # The rename publishes the finished segment to the indexer in one step
+        os.rename(self.segment_path + '.tmp', self.segment_path)
+        print(f"Saved segment: {self.segment_path}")
+        self.segment = None
+
+    def post_pending(self):
+        if not self.pending:
+            return
+        # Each record is a big-endian u32 URL length, a big-endian u32 HTML length, then both payloads
+        body = b''.join(struct.pack('>II', len(url), len(html)) + url + html for url, html in self.pending)
+        while True:
+            try:
+                response = requests.post(self.ingest_url, data=body, headers={'Content-Type': 'application/octet-stream'})
+            except requests.RequestException as e:
+                print(f"Ingest failed: {e}, retrying")
+                time.sleep(1)
+                continue
+            if response.status_code == 503:
+                # Indexer is saturated, back off as long as the server asks
+                time.sleep(int(response.headers.get('Retry-After', '1')))
+                continue
+            if response.status_code != 202:
+                print(f"Ingest rejected: {response.status_code}")
+            else:
+                print(f"Ingested: {len(self.pending)} pages")
+            break
+        self.pending = []
+
+    def ingest_page(self, url, content):
+        self.pending.append((url.encode('utf-8'), content.encode('utf-8')))
+        if len(self.pending) >= self.ingest_batch:
+            self.post_pending()
+
     def crawl(self, seed_url, max_pages=100):
         to_crawl = [seed_url]
         
@@ -67,16 +146,25 @@ class WebCrawler:
                 page_content = self.fetch_page(url)
                 if page_content:
                     self.visited_urls.add(url)
-                    self.save_page(url, page_content)
+                    if self.ingest_url:
+                        self.ingest_page(url, page_content)
+                    elif self.segment_bytes:
+                        self.append_segment(url, page_content)
+                    else:
+                        self.save_page(url, page_content)
                     new_links = self.extract_links(page_content, url)
                     to_crawl.extend(new_links - self.visited_urls)
                 time.sleep(self.delay)
 
+        if self.ingest_url:
+            self.post_pending()
+        self.close_segment()
         return self.visited_urls
 
 if __name__ == '__main__':
     seed_url = 'https://en.wikipedia.org/wiki/Main_Page'
-    crawler = WebCrawler(user_agent='MyCrawler', delay=1)
+    crawler = WebCrawler(user_agent='MyCrawler', delay=1, ingest_url=os.environ.get('INDEXSTREAM_INGEST_URL'),
+                         segment_bytes=int(os.environ.get('INDEXSTREAM_SEGMENT_BYTES', '0')))
     crawled_urls = crawler.crawl(seed_url, max_pages=1000000)
     print("Crawled URLs:")
     for url in crawled_urls:
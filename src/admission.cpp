@@ -0,0 +1,92 @@
+#include <algorithm>
+
+#include "admission.hpp"
+#include "config.hpp"
+
+namespace index_stream {
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Singleton static instance ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto AdmissionControl::get_instance() -> AdmissionControl& {
+        static AdmissionControl instance{};
+        return instance;
+    }
+
+    AdmissionControl::AdmissionControl()
+        : max_connections(Config::get().max_connections),
+          target(std::chrono::milliseconds(Config::get().queue_delay_target_ms)),
+          interval(std::chrono::milliseconds(Config::get().queue_delay_interval_ms)) {}
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ take a connection slot, or refuse past the cap ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto AdmissionControl::try_acquire() -> bool {
+        if (active.fetch_add(1, std::memory_order_relaxed) >= max_connections) {
+            active.fetch_sub(1, std::memory_order_relaxed);
+            refused.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        admitted.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    auto AdmissionControl::release() -> void {
+        active.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    auto AdmissionControl::enqueued() -> void {
+        queued.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ CoDel decision on one dequeued connection ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto AdmissionControl::dequeued(clock::duration waited) -> bool {
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        auto now = clock::now();
+        bool drop;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            last_delay = waited;
+
+            // Close the interval: the queue is overloaded if even its best delay missed the target
+            // A whole interval without connections means the queue drained
+            if (now >= interval_end) {
+                overloaded = interval_end != clock::time_point{} && now < interval_end + interval && min_delay > target;
+                min_delay = clock::duration::max();
+                interval_end = now + interval;
+            }
+            min_delay = std::min(min_delay, waited);
+
+            drop = waited > (overloaded ? target : interval);
+        }
+        if (drop)
+            shed.fetch_add(1, std::memory_order_relaxed);
+        return drop;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ one interval, rounded up to whole seconds ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto AdmissionControl::retry_after() const -> int {
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(interval).count();
+        return std::max<int>(1, static_cast<int>((ms + 999) / 1000));
+    }
+
+    auto AdmissionControl::watch(ThreadPool& pool) -> void {
+        std::unique_lock<std::mutex> lock(mutex);
+        this->pool = &pool;
+    }
+
+    auto AdmissionControl::stats() const -> Stats {
+        std::unique_lock<std::mutex> lock(mutex);
+        Stats stats {
+            active.load(std::memory_order_relaxed),
+            max_connections,
+            queued.load(std::memory_order_relaxed),
+            overloaded,
+            admitted.load(std::memory_order_relaxed),
+            refused.load(std::memory_order_relaxed),
+            shed.load(std::memory_order_relaxed),
+            std::chrono::duration<double, std::milli>(last_delay).count(),
+            {}
+        };
+        if (pool)
+            for (size_t i = 0; i < LANE_COUNT; i++)
+                stats.lanes[i] = pool->lane_stats(static_cast<Lane>(i));
+        return stats;
+    }
+}
@@ -0,0 +1,81 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <cstdint>
+
+#include "threadpool.hpp"
+
+#ifndef RFSS_ADMISSION_HPP
+#define RFSS_ADMISSION_HPP
+
+namespace index_stream {
+
+    // Admission control for the accept path. Connections beyond max_connections are refused on
+    // the accept thread; connections that waited too long in the ThreadPool queue are shed by
+    // the worker that picks them up, both with 503 + Retry-After.
+    //
+    // Queue shedding follows CoDel: if the smallest queue delay seen over a whole interval stays
+    // above the target, the queue is standing rather than absorbing a burst. While that holds,
+    // anything that queued longer than the target is shed; otherwise only connections that
+    // queued longer than a full interval are.
+    class AdmissionControl {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        static AdmissionControl& get_instance();
+        AdmissionControl(const AdmissionControl&) = delete;
+        AdmissionControl& operator=(const AdmissionControl&) = delete;
+
+        // Accept thread: false when the connection cap is reached. A true return must be paired
+        // with release() once the connection is closed
+        bool try_acquire();
+        void release();
+
+        // Called when a connection is handed to the ThreadPool, and by the worker that picks it
+        // up; dequeued returns true when a connection that waited `waited` should be shed
+        void enqueued();
+        bool dequeued(clock::duration waited);
+
+        // The pool connections are queued on, reported per lane in stats()
+        void watch(ThreadPool& pool);
+
+        // Seconds a shed client is told to wait before retrying
+        int retry_after() const;
+
+        struct Stats {
+            int active_connections;
+            int max_connections;
+            int queued;
+            bool overloaded;
+            uint64_t admitted;
+            uint64_t refused_connections;
+            uint64_t shed;
+            double last_delay_ms;
+            std::array<LaneStats, LANE_COUNT> lanes;
+        };
+        Stats stats() const;
+
+    private:
+        AdmissionControl();
+
+        const int max_connections;
+        const clock::duration target;
+        const clock::duration interval;
+
+        std::atomic<int> active {};
+        std::atomic<int> queued {};
+        std::atomic<uint64_t> admitted {};
+        std::atomic<uint64_t> refused {};
+        std::atomic<uint64_t> shed {};
+
+        ThreadPool* pool {};
+
+        mutable std::mutex mutex;
+        clock::time_point interval_end {};
+        clock::duration min_delay = clock::duration::max();
+        clock::duration last_delay {};
+        bool overloaded {};
+    };
+}
+
+#endif
@@ -0,0 +1,334 @@
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+#include "analyzer.hpp"
+#include "config.hpp"
+#include "tokenizer.hpp"
+
+namespace indexer {
+
+    // Default English stopword list, applied after normalization
+    static const char* const DEFAULT_STOPWORDS[] = {
+        "a", "about", "above", "after", "again", "against", "all", "am", "an", "and", "any", "are",
+        "as", "at", "be", "because", "been", "before", "being", "below", "between", "both", "but",
+        "by", "can", "could", "did", "do", "does", "doing", "down", "during", "each", "few", "for",
+        "from", "further", "had", "has", "have", "having", "he", "her", "here", "hers", "herself",
+        "him", "himself", "his", "how", "i", "if", "in", "into", "is", "it", "its", "itself", "just",
+        "me", "more", "most", "my", "myself", "no", "nor", "not", "now", "of", "off", "on", "once",
+        "only", "or", "other", "our", "ours", "ourselves", "out", "over", "own", "s", "same", "she",
+        "should", "so", "some", "such", "t", "than", "that", "the", "their", "theirs", "them",
+        "themselves", "then", "there", "these", "they", "this", "those", "through", "to", "too",
+        "under", "until", "up", "very", "was", "we", "were", "what", "when", "where", "which",
+        "while", "who", "whom", "why", "will", "with", "would", "you", "your", "yours", "yourself",
+        "yourselves"
+    };
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Porter stemmer state, b[k0..k] is the word being stemmed ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    // Straight port of Martin Porter's reference implementation, including its two departures
+    // (bli -> ble, logi -> log).
+    namespace {
+        struct PorterStemmer {
+            char* b;
+            int k;
+            int k0;
+            int j {};
+
+            bool cons(int i) const {
+                switch (b[i]) {
+                    case 'a': case 'e': case 'i': case 'o': case 'u': return false;
+                    case 'y': return (i == k0) ? true : !cons(i - 1);
+                    default: return true;
+                }
+            }
+
+            // number of consonant sequences between k0 and j
+            int m() const {
+                int n = 0;
+                int i = k0;
+                for (;;) {
+                    if (i > j) return n;
+                    if (!cons(i)) break;
+                    i++;
+                }
+                i++;
+                for (;;) {
+                    for (;;) {
+                        if (i > j) return n;
+                        if (cons(i)) break;
+                        i++;
+                    }
+                    i++;
+                    n++;
+                    for (;;) {
+                        if (i > j) return n;
+                        if (!cons(i)) break;
+                        i++;
+                    }
+                    i++;
+                }
+            }
+
+            bool vowel_in_stem() const {
+                for (int i = k0; i <= j; i++)
+                    if (!cons(i)) return true;
+                return false;
+            }
+
+            bool double_consonant(int i) const {
+                if (i < k0 + 1) return false;
+                if (b[i] != b[i - 1]) return false;
+                return cons(i);
+            }
+
+            // consonant-vowel-consonant ending at i, where the last consonant is not w, x or y
+            bool cvc(int i) const {
+                if (i < k0 + 2 || !cons(i) || cons(i - 1) || !cons(i - 2)) return false;
+                char ch = b[i];
+                return !(ch == 'w' || ch == 'x' || ch == 'y');
+            }
+
+            bool ends(std::string_view s) {
+                int length = static_cast<int>(s.size());
+                if (length > k - k0 + 1) return false;
+                if (std::memcmp(b + k - length + 1, s.data(), length) != 0) return false;
+                j = k - length;
+                return true;
+            }
+
+            void set_to(std::string_view s) {
+                std::memmove(b + j + 1, s.data(), s.size());
+                k = j + static_cast<int>(s.size());
+            }
+
+            void r(std::string_view s) {
+                if (m() > 0) set_to(s);
+            }
+
+            void step1ab() {
+                if (b[k] == 's') {
+                    if (ends("sses")) k -= 2;
+                    else if (ends("ies")) set_to("i");
+                    else if (b[k - 1] != 's') k--;
+                }
+                if (ends("eed")) {
+                    if (m() > 0) k--;
+                } else if ((ends("ed") || ends("ing")) && vowel_in_stem()) {
+                    k = j;
+                    if (ends("at")) set_to("ate");
+                    else if (ends("bl")) set_to("ble");
+                    else if (ends("iz")) set_to("ize");
+                    else if (double_consonant(k)) {
+                        k--;
+                        char ch = b[k];
+                        if (ch == 'l' || ch == 's' || ch == 'z') k++;
+                    }
+                    else if (m() == 1 && cvc(k)) set_to("e");
+                }
+            }
+
+            void step1c() {
+                if (ends("y") && vowel_in_stem()) b[k] = 'i';
+            }
+
+            void step2() {
+                switch (b[k - 1]) {
+                    case 'a':
+                        if (ends("ational")) { r("ate"); break; }
+                        if (ends("tional")) { r("tion"); break; }
+                        break;
+                    case 'c':
+                        if (ends("enci")) { r("ence"); break; }
+                        if (ends("anci")) { r("ance"); break; }
+                        break;
+                    case 'e':
+                        if (ends("izer")) { r("ize"); break; }
+                        break;
+                    case 'l':
+                        if (ends("bli")) { r("ble"); break; }
+                        if (ends("alli")) { r("al"); break; }
+                        if (ends("entli")) { r("ent"); break; }
+                        if (ends("eli")) { r("e"); break; }
+                        if (ends("ousli")) { r("ous"); break; }
+                        break;
+                    case 'o':
+                        if (ends("ization")) { r("ize"); break; }
+                        if (ends("ation")) { r("ate"); break; }
+                        if (ends("ator")) { r("ate"); break; }
+                        break;
+                    case 's':
+                        if (ends("alism")) { r("al"); break; }
+                        if (ends("iveness")) { r("ive"); break; }
+                        if (ends("fulness")) { r("ful"); break; }
+                        if (ends("ousness")) { r("ous"); break; }
+                        break;
+                    case 't':
+                        if (ends("aliti")) { r("al"); break; }
+                        if (ends("iviti")) { r("ive"); break; }
+                        if (ends("biliti")) { r("ble"); break; }
+                        break;
+                    case 'g':
+                        if (ends("logi")) { r("log"); break; }
+                        break;
+                }
+            }
+
+            void step3() {
+                switch (b[k]) {
+                    case 'e':
+                        if (ends("icate")) { r("ic"); break; }
+                        if (ends("ative")) { r(""); break; }
+                        if (ends("alize")) { r("al"); break; }
+                        break;
+                    case 'i':
+                        if (ends("iciti")) { r("ic"); break; }
+                        break;
+                    case 'l':
+                        if (ends("ical")) { r("ic"); break; }
+                        if (ends("ful")) { r(""); break; }
+                        break;
+                    case 's':
+                        if (ends("ness")) { r(""); break; }
+                        break;
+                }
+            }
+
+            void step4() {
+                switch (b[k - 1]) {
+                    case 'a':
+                        if (ends("al")) break;
+                        return;
+                    case 'c':
+                        if (ends("ance")) break;
+                        if (ends("ence")) break;
+                        return;
+                    case 'e':
+                        if (ends("er")) break;
+                        return;
+                    case 'i':
+                        if (ends("ic")) break;
+                        return;
+                    case 'l':
+                        if (ends("able")) break;
+                        if (ends("ible")) break;
+                        return;
+                    case 'n':
+                        if (ends("ant")) break;
+                        if (ends("ement")) break;
+                        if (ends("ment")) break;
+                        if (ends("ent")) break;
+                        return;
+                    case 'o':
+                        if (ends("ion") && j >= k0 && (b[j] == 's' || b[j] == 't')) break;
+                        if (ends("ou")) break;
+                        return;
+                    case 's':
+                        if (ends("ism")) break;
+                        return;
+                    case 't':
+                        if (ends("ate")) break;
+                        if (ends("iti")) break;
+                        return;
+                    case 'u':
+                        if (ends("ous")) break;
+                        return;
+                    case 'v':
+                        if (ends("ive")) break;
+                        return;
+                    case 'z':
+                        if (ends("ize")) break;
+                        return;
+                    default:
+                        return;
+                }
+                if (m() > 1) k = j;
+            }
+
+            void step5() {
+                j = k;
+                if (b[k] == 'e') {
+                    int a = m();
+                    if (a > 1 || (a == 1 && !cvc(k - 1))) k--;
+                }
+                if (b[k] == 'l' && double_consonant(k) && m() > 1) k--;
+            }
+        };
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ stem a word in place and return its new length ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto porter_stem(char* word, size_t length) -> size_t {
+        if (length <= 2)
+            return length;
+
+        // Only plain a-z words are stemmed, numbers and non-ASCII terms pass through
+        for (size_t i = 0; i < length; i++)
+            if (word[i] < 'a' || word[i] > 'z')
+                return length;
+
+        PorterStemmer stemmer {word, static_cast<int>(length) - 1, 0};
+        stemmer.step1ab();
+        if (stemmer.k > stemmer.k0) {
+            stemmer.step1c();
+            stemmer.step2();
+            stemmer.step3();
+            stemmer.step4();
+            stemmer.step5();
+        }
+        return static_cast<size_t>(stemmer.k + 1);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Singleton static instance ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto Analyzer::get_instance() -> const Analyzer& {
+        static const Analyzer instance{};
+        return instance;
+    }
+
+    Analyzer::Analyzer() {
+        const auto& config = index_stream::Config::get();
+        stem = config.stemming;
+        filter_stopwords = config.stopwords;
+
+        if (filter_stopwords) {
+            if (config.stopwords_file.empty())
+                stopword_storage.assign(std::begin(DEFAULT_STOPWORDS), std::end(DEFAULT_STOPWORDS));
+            else
+                load_stopwords(config.stopwords_file);
+
+            // Views are only taken once the storage has stopped growing
+            for (const auto& word : stopword_storage)
+                stopwords.insert(word);
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ load stopwords from file, normalized like any other text ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto Analyzer::load_stopwords(const std::string& file_name) -> void {
+        std::ifstream file(file_name);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open stopwords file: " << file_name << ", using built-in list" << std::endl;
+            stopword_storage.assign(std::begin(DEFAULT_STOPWORDS), std::end(DEFAULT_STOPWORDS));
+            return;
+        }
+
+        std::string line;
+        while (std::getline(file, line)) {
+            for_each_token(line.data(), line.size(), [&](std::string_view word) {
+                stopword_storage.emplace_back(word);
+            });
+        }
+    }
+
+    auto Analyzer::is_stopword(std::string_view term) const -> bool {
+        return filter_stopwords && stopwords.count(term) != 0;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ run the chain on one normalized token ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto Analyzer::apply(char* data, size_t length) const -> std::string_view {
+        if (is_stopword(std::string_view(data, length)))
+            return {};
+
+        if (stem)
+            length = porter_stem(data, length);
+
+        return std::string_view(data, length);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_set>
+
+namespace indexer {
+
+    // Porter stemmer working in place on a lowercase ASCII word. The stem is never longer than
+    // the input, so it can rewrite a token inside the normalized document buffer. Returns the
+    // new length.
+    size_t porter_stem(char* word, size_t length);
+
+    // Analysis chain run on every normalized token, on both the indexing and the query side:
+    // stopword filter, then stemming. Both stages are switched by Config.
+    class Analyzer {
+    public:
+        static const Analyzer& get_instance();
+        Analyzer(const Analyzer&) = delete;
+        Analyzer& operator=(const Analyzer&) = delete;
+
+        // Returns the analyzed term as a view into the same storage, or an empty view if the
+        // token was dropped
+        std::string_view apply(char* data, size_t length) const;
+        bool is_stopword(std::string_view term) const;
+
+    private:
+        bool stem {};
+        bool filter_stopwords {};
+        std::vector<std::string> stopword_storage;
+        std::unordered_set<std::string_view> stopwords;
+
+        Analyzer();
+        void load_stopwords(const std::string& file_name);
+    };
+}
@@ -0,0 +1,39 @@
+#include "arena.hpp"
+
+namespace index_stream {
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ allocate the bump block once per thread ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    RequestArena::RequestArena()
+        : block(std::make_unique<std::byte[]>(ARENA_BLOCK_SIZE)),
+          overflow(std::pmr::new_delete_resource()),
+          bump(block.get(), ARENA_BLOCK_SIZE, &overflow) {}
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ arena owned by the calling thread ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto RequestArena::local() -> RequestArena& {
+        thread_local RequestArena arena{};
+        return arena;
+    }
+
+    auto RequestArena::resource() -> std::pmr::memory_resource* {
+        return &bump;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ rewind the bump pointer, overflow chunks go back to the pool ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto RequestArena::reset() -> void {
+        bump.release();
+    }
+
+    ArenaScope::ArenaScope() : arena(RequestArena::local()) {
+        arena.depth++;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ only the outermost scope resets, nested scopes share it ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    ArenaScope::~ArenaScope() {
+        if (--arena.depth == 0)
+            arena.reset();
+    }
+
+    auto ArenaScope::resource() const -> std::pmr::memory_resource* {
+        return arena.resource();
+    }
+}
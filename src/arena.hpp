@@ -0,0 +1,51 @@
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+#ifndef RFSS_ARENA_HPP
+#define RFSS_ARENA_HPP
+
+namespace index_stream {
+
+    // Size of the bump region every worker thread owns for request scratch memory
+    const size_t ARENA_BLOCK_SIZE = 64 * 1024;
+
+    // Per-thread monotonic arena. Allocations are a pointer bump into a block owned by the
+    // thread; anything that overflows it is served by a thread-local pool that keeps its chunks
+    // around, so steady-state requests never touch the global allocator.
+    class RequestArena {
+    private:
+        std::unique_ptr<std::byte[]> block;
+        std::pmr::unsynchronized_pool_resource overflow;
+        std::pmr::monotonic_buffer_resource bump;
+        int depth {};
+        RequestArena();
+
+        friend class ArenaScope;
+
+    public:
+        RequestArena(const RequestArena&) = delete;
+        RequestArena& operator=(const RequestArena&) = delete;
+
+        static RequestArena& local();
+        std::pmr::memory_resource* resource();
+        void reset();
+    };
+
+    // Ties the arena to a request lifecycle: everything allocated while the outermost scope
+    // is alive is released in one go when it ends.
+    class ArenaScope {
+    private:
+        RequestArena& arena;
+
+    public:
+        ArenaScope();
+        ~ArenaScope();
+        ArenaScope(const ArenaScope&) = delete;
+        ArenaScope& operator=(const ArenaScope&) = delete;
+
+        std::pmr::memory_resource* resource() const;
+    };
+}
+
+#endif
@@ -0,0 +1,132 @@
+#include <thread>
+#include <algorithm>
+
+#include "config.hpp"
+
+namespace index_stream {
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ environment readers with defaults ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    static const char* env_value(const char* name) {
+        const char* value = std::getenv(name);
+        return (value && *value) ? value : nullptr;
+    }
+
+    static void env_bool(const char* name, bool& field) {
+        if (const char* value = env_value(name)) {
+            std::string v(value);
+            field = !(v == "0" || v == "false" || v == "off" || v == "no");
+        }
+    }
+
+    static void env_int(const char* name, int& field) {
+        if (const char* value = env_value(name))
+            field = std::atoi(value);
+    }
+
+    static void env_double(const char* name, double& field) {
+        if (const char* value = env_value(name))
+            field = std::atof(value);
+    }
+
+    static void env_string(const char* name, std::string& field) {
+        if (const char* value = env_value(name))
+            field = value;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Singleton static instance ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto Config::get() -> const Config& {
+        static const Config config = load();
+        return config;
+    }
+
+    auto Config::load() -> Config {
+        Config config {};
+        env_int("INDEXSTREAM_PORT", config.port);
+        env_string("INDEXSTREAM_DB_PATH", config.db_path);
+        env_string("INDEXSTREAM_DUMP_DIR", config.dump_dir);
+        env_string("INDEXSTREAM_ROLE", config.role);
+        env_string("INDEXSTREAM_SHARDS", config.shards);
+        env_int("INDEXSTREAM_SHARD_TIMEOUT_MS", config.shard_timeout_ms);
+        env_bool("INDEXSTREAM_STEMMING", config.stemming);
+        env_bool("INDEXSTREAM_STOPWORDS", config.stopwords);
+        env_string("INDEXSTREAM_STOPWORDS_FILE", config.stopwords_file);
+        env_string("INDEXSTREAM_DEDUP", config.dedup);
+        env_int("INDEXSTREAM_DEDUP_DISTANCE", config.dedup_distance);
+        env_string("INDEXSTREAM_INGEST", config.ingest);
+        env_int("INDEXSTREAM_INGEST_LATENCY_MS", config.ingest_latency_ms);
+        env_int("INDEXSTREAM_INGEST_BATCH_BYTES", config.ingest_batch_bytes);
+        env_int("INDEXSTREAM_INGEST_MAX_PENDING", config.ingest_max_pending);
+        env_int("INDEXSTREAM_BUILD_MEMORY_MB", config.build_memory_mb);
+        env_string("INDEXSTREAM_BUILD_TEMP_DIR", config.build_temp_dir);
+        env_bool("INDEXSTREAM_IMPACT_INDEX", config.impact_index);
+        env_int("INDEXSTREAM_POSTING_GENERATIONS", config.posting_generations);
+        env_string("INDEXSTREAM_TRACE_FILE", config.trace_file);
+        env_int("INDEXSTREAM_TRACE_BUFFER_EVENTS", config.trace_buffer_events);
+        env_int("INDEXSTREAM_SEARCH_SHARDS", config.search_shards);
+        env_int("INDEXSTREAM_SEARCH_TOP_K", config.search_top_k);
+        env_int("INDEXSTREAM_SEARCH_TIMEOUT_MS", config.search_timeout_ms);
+        env_string("INDEXSTREAM_SEARCH_TIMEOUT_MODE", config.search_timeout_mode);
+        env_bool("INDEXSTREAM_IMPACT_RESCORE", config.impact_rescore);
+        env_int("INDEXSTREAM_SLOW_QUERY_MS", config.slow_query_ms);
+        env_string("INDEXSTREAM_SLOW_QUERY_LOG", config.slow_query_log);
+        env_bool("INDEXSTREAM_STATIC_RANK", config.static_rank);
+        env_double("INDEXSTREAM_STATIC_RANK_WEIGHT", config.static_rank_weight);
+        env_int("INDEXSTREAM_STATIC_RANK_INTERVAL_S", config.static_rank_interval_s);
+        env_int("INDEXSTREAM_PAGERANK_ITERATIONS", config.pagerank_iterations);
+        env_double("INDEXSTREAM_PAGERANK_TOLERANCE", config.pagerank_tolerance);
+        env_double("INDEXSTREAM_PAGERANK_DAMPING", config.pagerank_damping);
+        env_int("INDEXSTREAM_PAGERANK_THREADS", config.pagerank_threads);
+        env_bool("INDEXSTREAM_STATIC_RANK_RENUMBER", config.static_rank_renumber);
+        env_bool("INDEXSTREAM_FUZZY", config.fuzzy);
+        env_int("INDEXSTREAM_FUZZY_MAX_EDITS", config.fuzzy_max_edits);
+        env_int("INDEXSTREAM_FUZZY_PREFIX", config.fuzzy_prefix);
+        env_int("INDEXSTREAM_FUZZY_MAX_EXPANSIONS", config.fuzzy_max_expansions);
+        env_int("INDEXSTREAM_FUZZY_MAX_SCAN", config.fuzzy_max_scan);
+        env_bool("INDEXSTREAM_SNIPPETS", config.snippets);
+        env_int("INDEXSTREAM_DOC_BLOCK_BYTES", config.doc_block_bytes);
+        env_int("INDEXSTREAM_SNIPPET_RESULTS", config.snippet_results);
+        env_int("INDEXSTREAM_MAX_REQUEST_BYTES", config.max_request_bytes);
+        env_int("INDEXSTREAM_SERVER_THREADS", config.server_threads);
+        env_int("INDEXSTREAM_INTERACTIVE_LANE_WEIGHT", config.interactive_lane_weight);
+        env_int("INDEXSTREAM_BULK_LANE_WEIGHT", config.bulk_lane_weight);
+        env_int("INDEXSTREAM_BULK_LANE_THREADS", config.bulk_lane_threads);
+        env_int("INDEXSTREAM_LISTEN_BACKLOG", config.listen_backlog);
+        env_int("INDEXSTREAM_LISTENERS", config.listeners);
+        env_bool("INDEXSTREAM_PIN_THREADS", config.pin_threads);
+        env_int("INDEXSTREAM_MAX_CONNECTIONS", config.max_connections);
+        env_int("INDEXSTREAM_GZIP_MIN_BYTES", config.gzip_min_bytes);
+        env_int("INDEXSTREAM_GZIP_LEVEL", config.gzip_level);
+        env_int("INDEXSTREAM_QUEUE_DELAY_TARGET_MS", config.queue_delay_target_ms);
+        env_int("INDEXSTREAM_QUEUE_DELAY_INTERVAL_MS", config.queue_delay_interval_ms);
+
+        if (config.search_shards <= 0)
+            config.search_shards = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        config.build_memory_mb = std::max(1, config.build_memory_mb);
+        config.posting_generations = std::max(2, config.posting_generations);
+        config.trace_buffer_events = std::max(16, config.trace_buffer_events);
+        config.ingest_latency_ms = std::max(0, config.ingest_latency_ms);
+        config.ingest_batch_bytes = std::max(1, config.ingest_batch_bytes);
+        config.ingest_max_pending = std::max(1, config.ingest_max_pending);
+        config.search_top_k = std::max(1, config.search_top_k);
+        config.static_rank_weight = std::max(0.0, config.static_rank_weight);
+        config.static_rank_interval_s = std::max(0, config.static_rank_interval_s);
+        config.pagerank_iterations = std::max(1, config.pagerank_iterations);
+        config.pagerank_damping = std::clamp(config.pagerank_damping, 0.0, 0.99);
+        config.pagerank_threads = std::max(0, config.pagerank_threads);
+        config.fuzzy_max_edits = std::clamp(config.fuzzy_max_edits, 0, 3);
+        config.fuzzy_prefix = std::max(0, config.fuzzy_prefix);
+        config.fuzzy_max_expansions = std::max(0, config.fuzzy_max_expansions);
+        config.fuzzy_max_scan = std::max(1, config.fuzzy_max_scan);
+        config.max_connections = std::max(1, config.max_connections);
+        config.gzip_min_bytes = std::max(0, config.gzip_min_bytes);
+        config.gzip_level = std::clamp(config.gzip_level, 1, 9);
+        config.server_threads = std::max(1, config.server_threads);
+        if (config.listeners <= 0)
+            config.listeners = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        config.interactive_lane_weight = std::max(1, config.interactive_lane_weight);
+        config.bulk_lane_weight = std::max(1, config.bulk_lane_weight);
+        config.bulk_lane_threads = std::clamp(config.bulk_lane_threads, 1, config.server_threads);
+        config.queue_delay_interval_ms = std::max(config.queue_delay_target_ms, config.queue_delay_interval_ms);
+        return config;
+    }
+}
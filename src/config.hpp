@@ -0,0 +1,103 @@
+#include <string>
+#include <cstdlib>
+
+#ifndef RFSS_CONFIG_HPP
+#define RFSS_CONFIG_HPP
+
+namespace index_stream {
+
+    // Runtime tunables. Every field can be overridden with an INDEXSTREAM_<FIELD> environment
+    // variable (upper-cased field name), read once on first use.
+    struct Config {
+        // process
+        int port = 8080;
+        std::string db_path = "../db/document_store.db";
+        std::string dump_dir = "../raw_dump";
+
+        // distributed search
+        std::string role = "shard";     // shard (owns an index) | coordinator (fans queries out to shards)
+        std::string shards {};          // coordinator only: comma-separated host:port list
+        int shard_timeout_ms = 1000;    // per fan-out phase; shards slower than this are left out
+
+        // analysis chain
+        bool stemming = true;
+        bool stopwords = true;
+        std::string stopwords_file {};  // one word per line, replaces the built-in list
+
+        // near-duplicate detection at ingest
+        std::string dedup = "skip";     // off | skip | collapse (skip, but remember the URL as an alias)
+        int dedup_distance = 3;         // max Hamming distance between SimHash fingerprints
+
+        // continuous ingest from the dump directory
+        std::string ingest = "inotify"; // inotify | poll (the old hourly update_db + merge_db cycle)
+        int ingest_latency_ms = 2000;   // a batch is published at most this long after its first file arrived
+        int ingest_batch_bytes = 8 << 20;  // ... or as soon as it holds this many bytes
+        int ingest_max_pending = 4;     // batches waiting for the indexer before the watcher stops reading events
+                                        // (and before POST /ingest answers 503)
+
+        // index build
+        int build_memory_mb = 256;      // memory for buffered postings before they are spilled to a sorted run
+        std::string build_temp_dir {};  // where runs are spilled, empty = next to the store
+        bool impact_index = false;      // store posting lists as 8-bit tf impacts instead of exact (frequency, length)
+        int posting_generations = 8;    // generations a posting list may stack up before compaction merges them
+
+        // ingest tracing
+        std::string trace_file {};      // Chrome trace-event JSON rewritten after every ingest cycle, empty = off
+        int trace_buffer_events = 65536;   // spans kept per thread, the oldest are overwritten
+
+        // search
+        int search_shards = 0;          // doc-id range shards scanned in parallel per query, 0 = one per core
+        int search_top_k = 100;         // results kept per shard and returned per query
+        int search_timeout_ms = 2000;   // per-query deadline, 0 = none; a request's timeout= may only shorten it
+        std::string search_timeout_mode = "partial";  // partial (best top k so far, flagged) | error (504)
+        bool impact_rescore = true;     // re-score the top k of impact lists exactly from the forward store
+        int slow_query_ms = 0;          // searches slower than this are logged with their profile, 0 = off
+        std::string slow_query_log {};  // file the slow-query log is appended to, empty = stderr
+
+        // static rank: PageRank over the link graph, blended into scores
+        bool static_rank = true;        // keep outlinks and compute PageRank
+        double static_rank_weight = 0.2;   // score x (1 + weight * ln(1 + rank)), rank scaled to mean 1
+        int static_rank_interval_s = 300;  // min time between recomputations during continuous ingest
+        int pagerank_iterations = 30;
+        double pagerank_tolerance = 1e-6;  // stop once the L1 change of an iteration falls below this
+        double pagerank_damping = 0.85;
+        int pagerank_threads = 2;       // rank pool threads helping the ingest thread, never the search workers
+        bool static_rank_renumber = false; // poll rebuilds renumber documents in static-rank order
+
+        // typo-tolerant matching of query terms missing from the dictionary
+        bool fuzzy = true;
+        int fuzzy_max_edits = 2;        // Levenshtein distance allowed for terms of 6+ bytes (1 for 3-5, 0 below)
+        int fuzzy_prefix = 1;           // leading bytes an expansion must share with the query term
+        int fuzzy_max_expansions = 4;   // closest dictionary terms kept per query term
+        int fuzzy_max_scan = 2000;      // dictionary terms visited per query term at most
+
+        // snippets
+        bool snippets = true;           // keep parsed text in the forward store and show excerpts
+        int doc_block_bytes = 16 << 10; // documents are compressed together in blocks of about this size
+        int snippet_results = 10;       // top results that get a snippet
+
+        // http
+        int max_request_bytes = 64 << 20;  // larger request bodies are refused with 413
+        int server_threads = 4;         // workers serving connections
+        int interactive_lane_weight = 8;   // scheduling share of searches and other GETs ...
+        int bulk_lane_weight = 1;       // ... against ingest bodies and deletes
+        int bulk_lane_threads = 1;      // workers bulk requests may occupy at once
+        int listen_backlog = 1024;      // pending connections the kernel queues before refusing
+        int listeners = 1;              // accept threads, each with its own SO_REUSEPORT socket, 0 = one per core
+        bool pin_threads = false;       // pin accept threads and workers round-robin to the allowed cores
+        int max_connections = 1024;     // open connections; more are refused with 503 on accept
+        int gzip_min_bytes = 1024;      // bodies at least this large are gzipped for clients that accept it, 0 = never
+        int gzip_level = 6;             // zlib level, 1 (fastest) to 9 (smallest)
+
+        // load shedding (CoDel on the worker queue)
+        int queue_delay_target_ms = 50;      // acceptable standing queue delay
+        int queue_delay_interval_ms = 500;   // window over which the minimum delay must stay above target
+
+        static const Config& get();
+
+    private:
+        static Config load();
+    };
+}
+
+#endif
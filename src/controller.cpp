@@ -5,7 +5,7 @@ namespace index_stream {
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Helper to send 400 response ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
     auto send_bad_request = [](int client_socket) {
         HTTPResponse response;
-        std::string http_response;
+        std::pmr::string http_response;
         response.status_code = 400;
         response.status_message = "Bad Request";
         http_response = response.generate_response();
@@ -15,7 +15,7 @@ namespace index_stream {
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Helper to send 500 response ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
     auto send_internal_server_error = [](int client_socket) {
         HTTPResponse response;
-        std::string http_response;
+        std::pmr::string http_response;
         response.status_code = 500;
         response.status_message = "Internal Server Error";
         http_response = response.generate_response();
@@ -25,13 +25,35 @@ namespace index_stream {
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Helper to send 404 response ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
     auto send_not_found_request = [](int client_socket) {
         HTTPResponse response;
-        std::string http_response;
+        std::pmr::string http_response;
         response.status_code = 404;
         response.status_message = "Unable to locate resource";
         http_response = response.generate_response();
         send(client_socket, http_response.c_str(), http_response.length(), 0);
     };
 
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Helper to send 503 response asking the client to retry later ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto send_service_unavailable = [](int client_socket, int retry_after) {
+        HTTPResponse response;
+        std::pmr::string http_response;
+        response.status_code = 503;
+        response.status_message = "Service Unavailable";
+        response.headers.emplace_back("Retry-After", std::to_string(retry_after));
+        http_response = response.generate_response();
+        send(client_socket, http_response.c_str(), http_response.length(), 0);
+    };
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Helper to send 504 response when a search ran out of time ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto send_search_timeout = [](int client_socket) {
+        HTTPResponse response;
+        std::pmr::string http_response;
+        response.status_code = 504;
+        response.status_message = "Gateway Timeout";
+        response.set_JSON_content("{\"error\":\"search deadline exceeded\"}");
+        http_response = response.generate_response();
+        send(client_socket, http_response.c_str(), http_response.length(), 0);
+    };
+
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Helper to print request ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
     std::ostream& operator<<(std::ostream& os, const HTTPRequest& req) {
         os << "Method: " << req.method << "\n";
@@ -52,32 +74,41 @@ namespace index_stream {
         return os;
     }
 
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Helper to decode a single hex digit ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    static int hex_value(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Helper to decode URL ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
-    auto url_decode(const std::string& str) -> std::string {
-        int i = 0;
-        std::stringstream decoded;
+    auto url_decode(std::string_view str, std::pmr::memory_resource* mr) -> std::pmr::string {
+        size_t i = 0;
+        std::pmr::string decoded(mr);
+        decoded.reserve(str.length());
 
         while (i < str.length()) {
             if (str[i] == '%') {
                 if (i + 2 < str.length()) {
-                    int hexValue;
-                    std::istringstream(str.substr(i + 1, 2)) >> std::hex >> hexValue;
-                    decoded << static_cast<char>(hexValue);
+                    int hi = hex_value(str[i + 1]);
+                    int lo = hex_value(str[i + 2]);
+                    decoded += static_cast<char>((hi < 0 || lo < 0) ? 0 : (hi << 4) | lo);
                     i += 3;
                 } else {
                     // If '%' is at the end of the string, leave it unchanged
-                    decoded << '%';
+                    decoded += '%';
                     i++;
                 }
             } else if (str[i] == '+') {
-                decoded << ' ';
+                decoded += ' ';
                 i++;
             } else {
-                decoded << str[i];
+                decoded += str[i];
                 i++;
             }
         }
-        return decoded.str();
+        return decoded;
     }
 
     // ~~~~~~~~~~~~~~~~~~~~~~~ Helper to get form values for field name ~~~~~~~~~~~~~~~~~~~~~~~
@@ -90,91 +121,298 @@ namespace index_stream {
             end_pos = (end_pos == std::string::npos) ? body.length() : end_pos;
             field_value = body.substr(pos, end_pos - pos);
         }
-        return url_decode(field_value);
+        return std::string(url_decode(field_value));
     }
 
+    // A static file as last read from disk, with its gzipped form (empty when gzip does not pay)
+    struct StaticAsset {
+        std::filesystem::file_time_type modified;
+        std::string content;
+        std::pmr::string gzipped;
+    };
+
     // ~~~~~~~~~~~~~~~~~~~~~~~ Helper to serve static HTML ~~~~~~~~~~~~~~~~~~~~~~~
-    auto serveStaticFile(const std::string& file_path, int client_socket) -> void {
-        std::ifstream file(file_path);
+    // Files are read and compressed once per modification time, then served from memory
+    auto serveStaticFile(const std::string& file_path, int client_socket, bool gzip) -> void {
+        static std::mutex assets_mutex;
+        static std::unordered_map<std::string, std::shared_ptr<const StaticAsset>> assets;
+
+        std::error_code error;
+        auto modified = std::filesystem::last_write_time(file_path, error);
+        if (error) {
+            send_not_found_request(client_socket);
+            return;
+        }
 
-        if (file.good()) {
+        std::shared_ptr<const StaticAsset> asset;
+        {
+            std::lock_guard<std::mutex> lock(assets_mutex);
+            auto it = assets.find(file_path);
+            if (it != assets.end() && it->second->modified == modified)
+                asset = it->second;
+        }
+
+        if (!asset) {
+            std::ifstream file(file_path);
+            if (!file.good()) {
+                send_not_found_request(client_socket);
+                return;
+            }
             std::stringstream buffer;
             buffer << file.rdbuf();
-            std::string content = buffer.str();
 
-            std::string response = "HTTP/1.1 200 OK\r\nContent-Length: "
-                                    + std::to_string(content.length())
-                                    + "\r\n\r\n"
-                                    + content;
+            auto loaded = std::make_shared<StaticAsset>();
+            loaded->modified = modified;
+            loaded->content = buffer.str();
+            const size_t gzip_min_bytes = static_cast<size_t>(Config::get().gzip_min_bytes);
+            if (gzip_min_bytes > 0 && loaded->content.length() >= gzip_min_bytes &&
+                (!gzip_compress(loaded->content, loaded->gzipped) || loaded->gzipped.length() >= loaded->content.length()))
+                loaded->gzipped.clear();
 
-            send(client_socket, response.c_str(), response.length(), 0);
+            asset = loaded;
+            std::lock_guard<std::mutex> lock(assets_mutex);
+            assets[file_path] = asset;
         }
-        else
-            send_not_found_request(client_socket);
+
+        bool gzipped = gzip && !asset->gzipped.empty();
+        std::string_view content = gzipped ? std::string_view(asset->gzipped) : std::string_view(asset->content);
+
+        std::string response = "HTTP/1.1 200 OK\r\n";
+        if (gzipped)
+            response += "Content-Encoding: gzip\r\n";
+        if (!asset->gzipped.empty())
+            response += "Vary: Accept-Encoding\r\n";
+        response.append("Content-Length: ").append(std::to_string(content.length())).append("\r\n\r\n").append(content);
+
+        send(client_socket, response.c_str(), response.length(), 0);
     }
 
     // ~~~~~~~~~~~~~~~~~~~~~~~ Helper to parse query parameters ~~~~~~~~~~~~~~~~~~~~~~~
-    auto parse_query_params(const std::string& query, std::unordered_map<std::string, std::string>& query_params) -> void {
+    auto parse_query_params(std::string_view query, query_map& query_params) -> void {
          
         size_t start = query.find('?') + 1;
         while (start < query.length()) {
             size_t end = query.find('&', start);  // Find the next '&'
-            std::string pair = (end == std::string::npos) ? query.substr(start) : query.substr(start, end - start);
+            std::string_view pair = (end == std::string_view::npos) ? query.substr(start) : query.substr(start, end - start);
             
             size_t delimiterPos = pair.find('=');
-            if (delimiterPos != std::string::npos) {
-                std::string key = pair.substr(0, delimiterPos);
-                std::string value = pair.substr(delimiterPos + 1);
-                query_params[key] = value;  // Store key-value pair
+            if (delimiterPos != std::string_view::npos) {
+                std::string_view key = pair.substr(0, delimiterPos);
+                std::string_view value = pair.substr(delimiterPos + 1);
+                query_params[std::pmr::string(key, query_params.get_allocator())] = value;  // Store key-value pair
             }
-            start = (end == std::string::npos) ? query.length() : end + 1;
+            start = (end == std::string_view::npos) ? query.length() : end + 1;
         }
     } 
 
+    // ~~~~~~~~~~~~~~~~~~~~~~~ Helper to read the search deadline of a request ~~~~~~~~~~~~~~~~~~~~~~~
+    // timeout= (milliseconds) may shorten the configured deadline, never extend it
+    static auto search_timeout(query_map& query_params) -> std::chrono::milliseconds {
+        int timeout = Config::get().search_timeout_ms;
+        auto it = query_params.find("timeout");
+        if (it != query_params.end()) {
+            int requested = std::atoi(it->second.c_str());
+            if (requested > 0 && (timeout <= 0 || requested < timeout))
+                timeout = requested;
+        }
+        return std::chrono::milliseconds(timeout);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~ Helper to tell whether a timed out search is answered with an error ~~~~~~~~~~~~~~~~~~~~~~~
+    static auto timed_out_as_error(const indexer::SearchDeadline& deadline) -> bool {
+        return deadline.expired && Config::get().search_timeout_mode == "error";
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~ Helper to append a JSON string literal ~~~~~~~~~~~~~~~~~~~~~~~
+    static void append_json_string(std::pmr::string& out, std::string_view value) {
+        out += '"';
+        for (unsigned char c : value) {
+            switch (c) {
+                case '"':  out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (c < 0x20) {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                        out += escaped;
+                    } else {
+                        out += static_cast<char>(c);
+                    }
+            }
+        }
+        out += '"';
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~ Helper to tell whether a search response carries its profile ~~~~~~~~~~~~~~~~~~~~~~~
+    static auto profile_requested(query_map& query_params) -> bool {
+        auto it = query_params.find("profile");
+        return it != query_params.end() && it->second == "1";
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~ Helper to append a search profile as a JSON object ~~~~~~~~~~~~~~~~~~~~~~~
+    static void append_profile_json(std::pmr::string& out, const indexer::SearchProfile& profile) {
+        char value[32];
+        auto milliseconds = [&](const char* name, double ms) {
+            std::snprintf(value, sizeof(value), "%.3f", ms);
+            out.append(out.back() == '{' ? "\"" : ",\"").append(name).append("_ms\":").append(value);
+        };
+        out += '{';
+        milliseconds("total", profile.total_ms);
+        milliseconds("search", profile.search_ms);
+        milliseconds("tokenize", profile.tokenize_ms);
+        milliseconds("dictionary", profile.dictionary_ms);
+        milliseconds("scoring", profile.scoring_ms);
+        milliseconds("rank", profile.rank_ms);
+        milliseconds("snippets", profile.snippets_ms);
+        milliseconds("render", profile.render_ms);
+        out.append(",\"shards\":").append(std::to_string(profile.shards));
+        out.append(",\"documents_scored\":").append(std::to_string(profile.documents_scored));
+        out.append(",\"page_cache\":{\"hits\":").append(std::to_string(profile.cache_hits));
+        out.append(",\"misses\":").append(std::to_string(profile.cache_misses)).append("}");
+        out += ",\"terms\":[";
+        for (size_t i = 0; i < profile.terms.size(); i++) {
+            const auto& term = profile.terms[i];
+            out += i > 0 ? ",{\"term\":" : "{\"term\":";
+            append_json_string(out, term.term);
+            out.append(",\"distance\":").append(std::to_string(term.distance));
+            out.append(",\"documents\":").append(std::to_string(term.document_count));
+            out.append(",\"postings_read\":").append(std::to_string(term.postings_read)).append("}");
+        }
+        out += "]}";
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~ Helper to append a search over the threshold to the slow-query log ~~~~~~~~~~~~~~~~~~~~~~~
+    // One line per search: local time, route, query and profile as JSON
+    static void log_slow_query(std::string_view route, std::string_view query, const indexer::SearchProfile& profile,
+                               std::pmr::memory_resource* mr) {
+        const auto& config = Config::get();
+        if (config.slow_query_ms <= 0 || profile.total_ms < config.slow_query_ms)
+            return;
+
+        char stamp[32];
+        std::time_t now = std::time(nullptr);
+        std::tm local {};
+        localtime_r(&now, &local);
+        std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &local);
+
+        std::pmr::string line(mr);
+        line.append(stamp).append(" ").append(route).append(" ");
+        append_json_string(line, query);
+        line += ' ';
+        append_profile_json(line, profile);
+        line += '\n';
+
+        static std::mutex log_mutex;
+        static std::ofstream log_file = config.slow_query_log.empty() ? std::ofstream() : std::ofstream(config.slow_query_log, std::ios::app);
+        std::lock_guard<std::mutex> lock(log_mutex);
+        if (log_file.is_open())
+            log_file << line << std::flush;
+        else
+            std::cerr << "Slow query: " << line;
+    }
+
     // ~~~~~~~~~~~~~~~~~~~~~~~ GET controller for home route ~~~~~~~~~~~~~~~~~~~~~~~
     auto handle_get_home(HTTPRequest& req, int client_socket) -> void {
-        serveStaticFile("../public/index.html", client_socket);
+        serveStaticFile("../public/index.html", client_socket, accepts_gzip(req));
     }
 
-    // ~~~~~~~~~~~~~~~~~~~~~~~ GET controller for home route ~~~~~~~~~~~~~~~~~~~~~~~
+    // ~~~~~~~~~~~~~~~~~~~~~~~ GET controller for search route ~~~~~~~~~~~~~~~~~~~~~~~
     auto handle_get_search(HTTPRequest& req, int client_socket) -> void {
-    HTTPResponse response {};
-    std::string http_response {}, query {};
-    std::unordered_map<std::string, std::string> query_params;
-
-    auto& idxr = indexer::Indexer::get_instance();
+    // Scratch for the whole request comes from the arena the request itself was parsed into
+    std::pmr::memory_resource* mr = req.resource();
+    HTTPResponse response(mr);
+    response.gzip = accepts_gzip(req);
+    std::pmr::string http_response(mr), query(mr);
+    query_map query_params(mr);
 
     // Parse the query parameter from the URI
     parse_query_params(req.URI, query_params);
-    query = url_decode(query_params["query"]);
+    query = url_decode(query_params["query"], mr);
+
+    // Profiled when asked for, or always with the slow-query log on since only the end tells
+    bool show_profile = profile_requested(query_params);
+    std::optional<indexer::SearchProfile> profile;
+    std::chrono::steady_clock::time_point started, stage;
+    if (show_profile || Config::get().slow_query_ms > 0) {
+        profile.emplace();
+        started = std::chrono::steady_clock::now();
+    }
 
-    // Perform the search
-    auto result_list = idxr.search(query);
+    // Perform the search, across all shards when this process is the coordinator
+    bool coordinator = Config::get().role == "coordinator";
+    indexer::SearchDeadline deadline(search_timeout(query_params));
+    indexer::SearchHits hits(mr);
+    auto result_list = coordinator
+        ? Coordinator::get_instance().search(query, mr).results
+        : indexer::Indexer::get_instance().search(query, mr, nullptr, &deadline, profile ? &*profile : nullptr, &hits);
+    if (timed_out_as_error(deadline)) {
+        send_search_timeout(client_socket);
+        return;
+    }
+    if (profile) {
+        profile->search_ms = indexer::SearchProfile::since(started);
+        stage = std::chrono::steady_clock::now();
+    }
+
+    // Excerpts come from this process's forward store, so only a shard has them
+    std::pmr::vector<std::pmr::string> snippets(mr);
+    if (!coordinator)
+        snippets = indexer::Indexer::get_instance().snippets(hits, mr);
+    if (profile) {
+        profile->snippets_ms = indexer::SearchProfile::since(stage);
+        stage = std::chrono::steady_clock::now();
+    }
 
     // Build HTML response dynamically
-    std::stringstream html;
-    html << "<div class='container mt-5'>";
+    std::pmr::string& html = response.body;
+    html.reserve(512 + result_list.size() * 256);
+    html += "<div class='container mt-5'>";
     
     if (result_list.empty()) {
-        html << "<h4 class='text-center text-muted'>No results found for \"" << query << "\"</h4>";
+        html.append("<h4 class='text-center text-muted'>No results found for \"").append(query).append("\"</h4>");
     } else {
-        html << "<h4 class='mb-4'>Search results for \"" << query << "\":</h4>";
-        html << "<div class='list-group'>";  // Using list-group for a clean layout
-        for (const auto& [key, val] : result_list) {
-            html << "<a href='" << key << "' class='list-group-item list-group-item-action'>";
-            html << "<h5 class='mb-1'>" << key << "</h5>";  // Result title
-            html << "<p class='mb-1 text-muted'>Link: " << key << "</p>";  // URL preview
-            html << "</a>";
+        html.append("<h4 class='mb-4'>Search results for \"").append(query).append("\":</h4>");
+        if (deadline.expired)
+            html += "<p class='text-muted'>The search ran out of time, these are the best results found so far.</p>";
+        html += "<div class='list-group'>";  // Using list-group for a clean layout
+        for (size_t i = 0; i < result_list.size(); i++) {
+            const auto& key = result_list[i].first;
+            html.append("<a href='").append(key).append("' class='list-group-item list-group-item-action'>");
+            html.append("<h5 class='mb-1'>").append(key).append("</h5>");  // Result title
+            if (i < snippets.size() && !snippets[i].empty())
+                html.append("<p class='mb-1'>").append(snippets[i]).append("</p>");  // Highlighted excerpt
+            html.append("<p class='mb-1 text-muted'>Link: ").append(key).append("</p>");  // URL preview
+            html += "</a>";
+        }
+        html += "</div>";
+    }
+
+    if (profile) {
+        profile->render_ms = indexer::SearchProfile::since(stage);
+        profile->total_ms = indexer::SearchProfile::since(started);
+        log_slow_query("/search", query, *profile, mr);
+    }
+    if (show_profile) {
+        std::pmr::string breakdown(mr);
+        append_profile_json(breakdown, *profile);
+        html += "<pre class='mt-4 small text-muted'>";
+        for (char c : breakdown) {
+            if (c == '<') html += "&lt;";
+            else if (c == '>') html += "&gt;";
+            else if (c == '&') html += "&amp;";
+            else html += c;
         }
-        html << "</div>";
+        html += "</pre>";
     }
     
-    html << "</div>";
+    html += "</div>";
 
     // Set up HTTP response
     response.status_code = 200;
     response.status_message = "OK";
-    response.body = html.str();  // Send the HTML content as the body of the response
 
     // Generate the full HTTP response
     http_response = response.generate_response();
@@ -183,6 +421,309 @@ namespace index_stream {
     send(client_socket, http_response.c_str(), http_response.length(), 0);
 }
 
+    // ~~~~~~~~~~~~~~~~~~~~~~~ DELETE controller for document route ~~~~~~~~~~~~~~~~~~~~~~~
+    auto handle_delete_document(HTTPRequest& req, int client_socket) -> void {
+        std::pmr::memory_resource* mr = req.resource();
+        HTTPResponse response(mr);
+        query_map query_params(mr);
+
+        parse_query_params(req.URI, query_params);
+        std::string url(url_decode(query_params["url"], mr));
+
+        if (url.empty()) {
+            send_bad_request(client_socket);
+            return;
+        }
+
+        if (!indexer::Indexer::get_instance().delete_document(url)) {
+            send_not_found_request(client_socket);
+            return;
+        }
+
+        response.status_code = 200;
+        response.status_message = "OK";
+        response.set_JSON_content("{\"deleted\":true}");
+
+        std::pmr::string http_response = response.generate_response();
+        send(client_socket, http_response.c_str(), http_response.length(), 0);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~ Helper to read a big-endian u32 length prefix ~~~~~~~~~~~~~~~~~~~~~~~
+    static uint32_t read_u32_be(const char* data) {
+        const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+        return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~ POST controller for ingest route ~~~~~~~~~~~~~~~~~~~~~~~
+    // The body is a run of records, each a big-endian u32 URL length, a big-endian u32 HTML
+    // length, then the URL and HTML bytes. The whole body is queued as one indexing batch.
+    auto handle_post_ingest(HTTPRequest& req, int client_socket) -> void {
+        auto& watcher = IngestWatcher::get_instance();
+        if (!watcher.running()) {
+            send_service_unavailable(client_socket, 5);
+            return;
+        }
+
+        std::vector<indexer::IngestRecord> records;
+        std::string_view body = req.body;
+        while (!body.empty()) {
+            if (body.size() < 8) {
+                send_bad_request(client_socket);
+                return;
+            }
+            size_t url_length = read_u32_be(body.data());
+            size_t html_length = read_u32_be(body.data() + 4);
+            body.remove_prefix(8);
+            if (url_length == 0 || url_length > body.size() || html_length > body.size() - url_length) {
+                send_bad_request(client_socket);
+                return;
+            }
+            records.push_back({std::string(body.substr(0, url_length)), std::string(body.substr(url_length, html_length))});
+            body.remove_prefix(url_length + html_length);
+        }
+
+        if (records.empty()) {
+            send_bad_request(client_socket);
+            return;
+        }
+
+        size_t accepted = records.size();
+        if (!watcher.submit(std::move(records), req.body.size())) {
+            // Roughly one publish interval, by then the indexer has taken a batch
+            int retry_after = std::max(1, Config::get().ingest_latency_ms / 1000);
+            send_service_unavailable(client_socket, retry_after);
+            return;
+        }
+
+        HTTPResponse response(req.resource());
+        response.status_code = 202;
+        response.status_message = "Accepted";
+        response.set_JSON_content("{\"accepted\":" + std::to_string(accepted) + "}");
+
+        std::pmr::string http_response = response.generate_response();
+        send(client_socket, http_response.c_str(), http_response.length(), 0);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~ GET controller for JSON search route ~~~~~~~~~~~~~~~~~~~~~~~
+    // Local search on a shard, scatter-gather over all shards on the coordinator
+    auto handle_get_api_search(HTTPRequest& req, int client_socket) -> void {
+        std::pmr::memory_resource* mr = req.resource();
+        HTTPResponse response(mr);
+        response.gzip = accepts_gzip(req);
+        query_map query_params(mr);
+
+        parse_query_params(req.URI, query_params);
+        std::pmr::string query = url_decode(query_params["query"], mr);
+
+        bool show_profile = profile_requested(query_params);
+        std::optional<indexer::SearchProfile> profile;
+        std::chrono::steady_clock::time_point started, stage;
+        if (show_profile || Config::get().slow_query_ms > 0) {
+            profile.emplace();
+            started = std::chrono::steady_clock::now();
+        }
+
+        bool partial = false;
+        size_t shards_answered = 1, shards_total = 1;
+        std::pmr::vector<std::pair<std::pmr::string, double>> result_list(mr);
+        std::pmr::vector<std::pmr::string> snippets(mr);
+        if (Config::get().role == "coordinator") {
+            auto distributed = Coordinator::get_instance().search(query, mr);
+            result_list = std::move(distributed.results);
+            partial = distributed.partial();
+            shards_answered = distributed.shards_answered;
+            shards_total = distributed.shards_total;
+            if (profile)
+                profile->search_ms = indexer::SearchProfile::since(started);
+        } else {
+            indexer::SearchDeadline deadline(search_timeout(query_params));
+            indexer::SearchHits hits(mr);
+            result_list = indexer::Indexer::get_instance().search(query, mr, nullptr, &deadline, profile ? &*profile : nullptr, &hits);
+            if (timed_out_as_error(deadline)) {
+                send_search_timeout(client_socket);
+                return;
+            }
+            partial = deadline.expired;
+            if (profile) {
+                profile->search_ms = indexer::SearchProfile::since(started);
+                stage = std::chrono::steady_clock::now();
+            }
+            snippets = indexer::Indexer::get_instance().snippets(hits, mr);
+            if (profile)
+                profile->snippets_ms = indexer::SearchProfile::since(stage);
+        }
+        if (profile)
+            stage = std::chrono::steady_clock::now();
+
+        std::pmr::string& json = response.body;
+        json.reserve(128 + result_list.size() * 128);
+        json += "{\"query\":";
+        append_json_string(json, query);
+        json.append(",\"partial\":").append(partial ? "true" : "false");
+        json.append(",\"shards\":{\"answered\":").append(std::to_string(shards_answered));
+        json.append(",\"total\":").append(std::to_string(shards_total)).append("}");
+        json += ",\"results\":[";
+        char score[32];
+        for (size_t i = 0; i < result_list.size(); i++) {
+            if (i > 0)
+                json += ',';
+            json += "{\"url\":";
+            append_json_string(json, result_list[i].first);
+            std::snprintf(score, sizeof(score), "%.6g", result_list[i].second);
+            json.append(",\"score\":").append(score);
+            if (i < snippets.size() && !snippets[i].empty()) {
+                json += ",\"snippet\":";
+                append_json_string(json, snippets[i]);
+            }
+            json += "}";
+        }
+        json += "]";
+
+        if (profile) {
+            profile->render_ms = indexer::SearchProfile::since(stage);
+            profile->total_ms = indexer::SearchProfile::since(started);
+            log_slow_query("/api/search", query, *profile, mr);
+        }
+        if (show_profile) {
+            json += ",\"profile\":";
+            append_profile_json(json, *profile);
+        }
+        json += "}";
+
+        response.status_code = 200;
+        response.status_message = "OK";
+        response.content_type = "application/json";
 
+        std::pmr::string http_response = response.generate_response();
+        send(client_socket, http_response.c_str(), http_response.length(), 0);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~ GET controller for shard statistics (coordinator phase 1) ~~~~~~~~~~~~~~~~~~~~~~~
+    auto handle_get_shard_stats(HTTPRequest& req, int client_socket) -> void {
+        std::pmr::memory_resource* mr = req.resource();
+        HTTPResponse response(mr);
+        response.gzip = accepts_gzip(req);
+        query_map query_params(mr);
+
+        parse_query_params(req.URI, query_params);
+        std::pmr::string query = url_decode(query_params["query"], mr);
+        auto statistics = indexer::Indexer::get_instance().term_statistics(query, mr);
+
+        std::pmr::string& body = response.body;
+        body.append("documents\t").append(std::to_string(statistics.documents)).append("\n");
+        for (const auto& [term, count] : statistics.document_counts)
+            body.append(term).append("\t").append(std::to_string(count)).append("\n");
+
+        response.status_code = 200;
+        response.status_message = "OK";
+
+        std::pmr::string http_response = response.generate_response();
+        send(client_socket, http_response.c_str(), http_response.length(), 0);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~ GET controller for shard top-k under global IDF (coordinator phase 2) ~~~~~~~~~~~~~~~~~~~~~~~
+    auto handle_get_shard_search(HTTPRequest& req, int client_socket) -> void {
+        std::pmr::memory_resource* mr = req.resource();
+        HTTPResponse response(mr);
+        response.gzip = accepts_gzip(req);
+        query_map query_params(mr);
+
+        parse_query_params(req.URI, query_params);
+        std::pmr::string query = url_decode(query_params["query"], mr);
+
+        // idf=term:value,term:value
+        indexer::idf_map global_idf(mr);
+        std::pmr::string idf_list = url_decode(query_params["idf"], mr);
+        std::string_view rest = idf_list;
+        while (!rest.empty()) {
+            size_t end = rest.find(',');
+            std::string_view entry = rest.substr(0, end);
+            rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end + 1);
+            size_t colon = entry.rfind(':');
+            if (colon != std::string_view::npos)
+                global_idf[std::pmr::string(entry.substr(0, colon), mr)] = std::atof(std::string(entry.substr(colon + 1)).c_str());
+        }
+
+        // A coordinator's profile stops at the fan-out, the shards log their own slow searches
+        std::optional<indexer::SearchProfile> profile;
+        std::chrono::steady_clock::time_point started;
+        if (Config::get().slow_query_ms > 0) {
+            profile.emplace();
+            started = std::chrono::steady_clock::now();
+        }
+
+        indexer::SearchDeadline deadline(search_timeout(query_params));
+        auto result_list = indexer::Indexer::get_instance().search(query, mr, &global_idf, &deadline, profile ? &*profile : nullptr);
+        if (timed_out_as_error(deadline)) {
+            send_search_timeout(client_socket);
+            return;
+        }
+        if (profile) {
+            profile->search_ms = profile->total_ms = indexer::SearchProfile::since(started);
+            log_slow_query("/api/shard/search", query, *profile, mr);
+        }
+
+        std::pmr::string& body = response.body;
+        if (deadline.expired)
+            body.append("partial\n");
+        char score[32];
+        for (const auto& [url, value] : result_list) {
+            std::snprintf(score, sizeof(score), "%.17g", value);
+            body.append(score).append("\t").append(url).append("\n");
+        }
+
+        response.status_code = 200;
+        response.status_message = "OK";
+
+        std::pmr::string http_response = response.generate_response();
+        send(client_socket, http_response.c_str(), http_response.length(), 0);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~ GET controller for server status ~~~~~~~~~~~~~~~~~~~~~~~
+    // Admission counters, so load balancers and dashboards can see shedding as it happens
+    auto handle_get_api_status(HTTPRequest& req, int client_socket) -> void {
+        HTTPResponse response(req.resource());
+        response.gzip = accepts_gzip(req);
+        auto stats = AdmissionControl::get_instance().stats();
+
+        char last_delay[32];
+        std::snprintf(last_delay, sizeof(last_delay), "%.3f", stats.last_delay_ms);
+
+        std::pmr::string& json = response.body;
+        json += "{\"role\":";
+        append_json_string(json, Config::get().role);
+        json.append(",\"connections\":{\"active\":").append(std::to_string(stats.active_connections));
+        json.append(",\"max\":").append(std::to_string(stats.max_connections));
+        json.append(",\"admitted\":").append(std::to_string(stats.admitted));
+        json.append(",\"refused\":").append(std::to_string(stats.refused_connections)).append("}");
+        json.append(",\"queue\":{\"depth\":").append(std::to_string(stats.queued));
+        json.append(",\"last_delay_ms\":").append(last_delay);
+        json.append(",\"overloaded\":").append(stats.overloaded ? "true" : "false");
+        json.append(",\"shed\":").append(std::to_string(stats.shed)).append("}");
+        json += ",\"lanes\":{";
+        static const char* const lane_names[LANE_COUNT] = {"interactive", "bulk"};
+        for (size_t i = 0; i < LANE_COUNT; i++) {
+            const auto& lane = stats.lanes[i];
+            char max_wait[32];
+            std::snprintf(max_wait, sizeof(max_wait), "%.3f", lane.max_wait_ms);
+            json.append(i > 0 ? ",\"" : "\"").append(lane_names[i]).append("\":{\"queued\":").append(std::to_string(lane.queued));
+            json.append(",\"active\":").append(std::to_string(lane.active));
+            if (lane.max_active != SIZE_MAX)
+                json.append(",\"limit\":").append(std::to_string(lane.max_active));
+            json.append(",\"executed\":").append(std::to_string(lane.executed));
+            json.append(",\"max_wait_ms\":").append(max_wait).append("}");
+        }
+        json += "}";
+        if (Config::get().role != "coordinator")
+            json.append(",\"search\":{\"timed_out\":").append(std::to_string(indexer::Indexer::get_instance().timed_out_queries())).append("}");
+        json += "}";
+
+        response.status_code = 200;
+        response.status_message = "OK";
+        response.content_type = "application/json";
+
+        std::pmr::string http_response = response.generate_response();
+        send(client_socket, http_response.c_str(), http_response.length(), 0);
+    }
 
 }
\ No newline at end of file
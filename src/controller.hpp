@@ -5,10 +5,22 @@
 #include <sstream>
 #include <sys/socket.h>
 #include <unordered_map>
+#include <string_view>
+#include <memory_resource>
 #include <ctime>
+#include <algorithm>
+#include <optional>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
 
 #include "http.hpp"
 #include "indexer.hpp"
+#include "ingest_watcher.hpp"
+#include "config.hpp"
+#include "coordinator.hpp"
+#include "admission.hpp"
 
 #ifndef RFSS_CONTROLLER_HPP
 #define RFSS_CONTRILLER_HPP
@@ -16,11 +28,11 @@
 namespace index_stream {
 
     // helpers
-    void serveStaticFile(const std::string& file_path, int client_socket);
+    void serveStaticFile(const std::string& file_path, int client_socket, bool gzip = false);
     std::unordered_map<std::string, std::string> parse_parameters(std::string uri);
     std::ostream& operator<<(std::ostream& os, const HTTPRequest& req);
     std::string get_form_field(const std::string& body, const std::string& field_name);
-    std::string url_decode(const std::string& str);
+    std::pmr::string url_decode(std::string_view str, std::pmr::memory_resource* mr = std::pmr::get_default_resource());
     void update_db();
 
 
@@ -28,6 +40,12 @@ namespace index_stream {
     // controllers
     void handle_get_home(HTTPRequest& req, int client_socket);
     void handle_get_search(HTTPRequest& req, int client_socket);
+    void handle_delete_document(HTTPRequest& req, int client_socket);
+    void handle_post_ingest(HTTPRequest& req, int client_socket);
+    void handle_get_api_search(HTTPRequest& req, int client_socket);
+    void handle_get_shard_stats(HTTPRequest& req, int client_socket);
+    void handle_get_shard_search(HTTPRequest& req, int client_socket);
+    void handle_get_api_status(HTTPRequest& req, int client_socket);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <unordered_map>
+
+#include "coordinator.hpp"
+#include "http_client.hpp"
+#include "config.hpp"
+
+namespace index_stream {
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Singleton static instance ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto Coordinator::get_instance() -> Coordinator& {
+        static Coordinator instance{};
+        return instance;
+    }
+
+    Coordinator::Coordinator()
+        : shards(parse_shards(Config::get().shards)),
+          fanout_pool(std::max<size_t>(1, shards.size())) {
+        std::cout << "Coordinating " << shards.size() << " shards" << std::endl;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ "host:port,host:port" -> addresses ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto Coordinator::parse_shards(const std::string& list) -> std::vector<ShardAddress> {
+        std::vector<ShardAddress> addresses;
+        size_t start = 0;
+        while (start < list.size()) {
+            size_t end = list.find(',', start);
+            std::string entry = list.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            size_t colon = entry.rfind(':');
+            if (colon != std::string::npos && colon > 0)
+                addresses.push_back({entry.substr(0, colon), std::atoi(entry.c_str() + colon + 1)});
+            else if (!entry.empty())
+                std::cerr << "Ignoring shard address without port: " << entry << std::endl;
+            start = end == std::string::npos ? list.size() : end + 1;
+        }
+        return addresses;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ percent-encode a query parameter value ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    static std::string url_encode(std::string_view value) {
+        static const char hex[] = "0123456789ABCDEF";
+        std::string encoded;
+        encoded.reserve(value.size() * 3);
+        for (unsigned char c : value) {
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.') {
+                encoded += static_cast<char>(c);
+            } else {
+                encoded += '%';
+                encoded += hex[c >> 4];
+                encoded += hex[c & 15];
+            }
+        }
+        return encoded;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ one GET per target shard, all in flight at once ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto Coordinator::fan_out(const std::vector<size_t>& targets, const std::vector<std::string>& paths,
+                              std::chrono::steady_clock::time_point deadline) -> std::vector<std::optional<std::string>> {
+        std::vector<std::future<std::optional<std::string>>> replies;
+        replies.reserve(targets.size());
+        for (size_t i = 0; i < targets.size(); i++) {
+            // Tasks own copies of everything they touch, so a straggler can outlive this call
+            ShardAddress shard = shards[targets[i]];
+            std::string path = paths[i];
+            replies.push_back(fanout_pool.submit([shard, path, deadline]() -> std::optional<std::string> {
+                std::string body;
+                int status = http_get(shard.host, shard.port, path, deadline, body);
+                if (status != 200) {
+                    std::cerr << "Shard " << shard.host << ":" << shard.port << " failed (" << (status ? "HTTP " + std::to_string(status) : std::string("unreachable or timed out")) << ")" << std::endl;
+                    return std::nullopt;
+                }
+                return body;
+            }));
+        }
+
+        std::vector<std::optional<std::string>> bodies(targets.size());
+        for (size_t i = 0; i < replies.size(); i++) {
+            // http_get honours the deadline itself, the grace period only covers scheduling
+            if (replies[i].wait_until(deadline + std::chrono::milliseconds(50)) == std::future_status::ready)
+                bodies[i] = replies[i].get();
+        }
+        return bodies;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ two-phase scatter-gather over all shards ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto Coordinator::search(std::string_view query, std::pmr::memory_resource* mr) -> DistributedResult {
+        const auto& config = Config::get();
+        const auto timeout = std::chrono::milliseconds(config.shard_timeout_ms);
+        DistributedResult result(mr);
+        result.shards_total = shards.size();
+        std::string encoded_query = url_encode(query);
+
+        // Phase 1: corpus size and document counts of the analyzed query terms, one line each
+        //   documents\t<N>
+        //   <term>\t<df>
+        std::vector<size_t> targets(shards.size());
+        std::vector<std::string> paths(shards.size(), "/api/shard/stats?query=" + encoded_query);
+        for (size_t i = 0; i < shards.size(); i++)
+            targets[i] = i;
+        auto stats = fan_out(targets, paths, std::chrono::steady_clock::now() + timeout);
+
+        long long documents = 0;
+        std::vector<std::string> terms;
+        std::unordered_map<std::string, long long> document_counts;
+        std::vector<size_t> answered;
+        for (size_t i = 0; i < stats.size(); i++) {
+            if (!stats[i])
+                continue;
+            answered.push_back(i);
+            std::string_view body = *stats[i];
+            while (!body.empty()) {
+                size_t end = body.find('\n');
+                std::string_view line = body.substr(0, end);
+                body = end == std::string_view::npos ? std::string_view{} : body.substr(end + 1);
+                size_t tab = line.find('\t');
+                if (tab == std::string_view::npos)
+                    continue;
+                std::string key(line.substr(0, tab));
+                long long value = std::atoll(std::string(line.substr(tab + 1)).c_str());
+                if (key == "documents") {
+                    documents += value;
+                } else {
+                    auto [it, inserted] = document_counts.emplace(key, 0);
+                    if (inserted)
+                        terms.push_back(key);
+                    it->second += value;
+                }
+            }
+        }
+        if (answered.empty() || terms.empty())
+            return result;
+
+        // Same IDF the indexer uses, but over the whole corpus
+        std::string idf_param;
+        for (const auto& term : terms) {
+            double idf = std::log(static_cast<double>(documents) / (document_counts[term] + 1));
+            char value[32];
+            std::snprintf(value, sizeof(value), "%.17g", idf);
+            if (!idf_param.empty())
+                idf_param += ',';
+            idf_param.append(term).append(":").append(value);
+        }
+
+        // Phase 2: every shard that answered scores with the global IDF and returns its top k,
+        //   <score>\t<url>
+        // preceded by a bare "partial" line if it ran out of time. Shards get four fifths of the
+        // phase deadline for scoring so a partial top k still makes it back in time.
+        std::string shard_timeout = std::to_string(std::max(1, config.shard_timeout_ms * 4 / 5));
+        paths.assign(answered.size(), "/api/shard/search?query=" + encoded_query + "&idf=" + url_encode(idf_param) + "&timeout=" + shard_timeout);
+        auto replies = fan_out(answered, paths, std::chrono::steady_clock::now() + timeout);
+
+        std::vector<std::pair<double, std::string>> merged;
+        for (const auto& reply : replies) {
+            if (!reply)
+                continue;
+            result.shards_answered++;
+            std::string_view body = *reply;
+            while (!body.empty()) {
+                size_t end = body.find('\n');
+                std::string_view line = body.substr(0, end);
+                body = end == std::string_view::npos ? std::string_view{} : body.substr(end + 1);
+                if (line == "partial")
+                    result.timed_out = true;
+                size_t tab = line.find('\t');
+                if (tab != std::string_view::npos)
+                    merged.emplace_back(std::atof(std::string(line.substr(0, tab)).c_str()), std::string(line.substr(tab + 1)));
+            }
+        }
+
+        size_t keep = std::min(static_cast<size_t>(config.search_top_k), merged.size());
+        std::partial_sort(merged.begin(), merged.begin() + keep, merged.end(),
+                          [](const auto& a, const auto& b) { return a.first != b.first ? a.first > b.first : a.second < b.second; });
+        result.results.reserve(keep);
+        for (size_t i = 0; i < keep; i++)
+            result.results.emplace_back(std::pmr::string(merged[i].second, mr), merged[i].first);
+        return result;
+    }
+}
@@ -0,0 +1,58 @@
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <chrono>
+#include <memory_resource>
+
+#include "threadpool.hpp"
+
+#ifndef RFSS_COORDINATOR_HPP
+#define RFSS_COORDINATOR_HPP
+
+namespace index_stream {
+
+    struct ShardAddress {
+        std::string host;
+        int port {};
+    };
+
+    // Results merged from every shard that answered, with how many did
+    struct DistributedResult {
+        std::pmr::vector<std::pair<std::pmr::string, double>> results;
+        size_t shards_answered {};
+        size_t shards_total {};
+        bool timed_out {};  // some shard hit its search deadline and returned a partial top k
+
+        explicit DistributedResult(std::pmr::memory_resource* mr) : results(mr) {}
+        bool partial() const { return timed_out || shards_answered < shards_total; }
+    };
+
+    // Coordinator role: owns no index, fans each query out to the shard servers in two phases.
+    // First every shard reports its corpus size and the document counts of the query terms,
+    // summed into one global IDF per term. Then every shard scores its documents with that IDF
+    // and returns its top k, which are merged here. Shards that miss a phase deadline are left
+    // out and the result is marked partial.
+    class Coordinator {
+    public:
+        static Coordinator& get_instance();
+        Coordinator(const Coordinator&) = delete;
+        Coordinator& operator=(const Coordinator&) = delete;
+
+        DistributedResult search(std::string_view query, std::pmr::memory_resource* mr);
+
+    private:
+        std::vector<ShardAddress> shards;
+        ThreadPool fanout_pool;
+
+        Coordinator();
+        static std::vector<ShardAddress> parse_shards(const std::string& list);
+
+        // GETs the path from each listed shard concurrently; shards that failed or ran out of
+        // time have no body
+        std::vector<std::optional<std::string>> fan_out(const std::vector<size_t>& targets, const std::vector<std::string>& paths,
+                                         std::chrono::steady_clock::time_point deadline);
+    };
+}
+
+#endif
@@ -0,0 +1,248 @@
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <zlib.h>
+
+#include "doc_store.hpp"
+#include "simhash.hpp"
+#include "config.hpp"
+
+namespace indexer {
+
+    // Tokens on either side of the best match window that make it into a snippet
+    const size_t SNIPPET_TOKENS = 24;
+
+    auto token_hash(std::string_view analyzed_term) -> uint32_t {
+        return static_cast<uint32_t>(hash_term(analyzed_term));
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ block and location tables ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto DocumentStore::create_tables(sqlite3* db) -> void {
+        const char* create_blocks_table = R"(
+            CREATE TABLE IF NOT EXISTS doc_blocks (
+                block_id INTEGER PRIMARY KEY AUTOINCREMENT,
+                raw_size INTEGER, -- size of the block once inflated
+                data BLOB -- zlib-compressed run of document records
+            );
+        )";
+
+        const char* create_locations_table = R"(
+            CREATE TABLE IF NOT EXISTS doc_locations (
+                document_id INTEGER PRIMARY KEY,
+                block_id INTEGER,
+                offset INTEGER, -- byte offset of the record inside the inflated block
+                length INTEGER,
+                FOREIGN KEY (block_id) REFERENCES doc_blocks(block_id)
+            );
+        )";
+
+        const char* create_block_index = R"(
+            CREATE INDEX IF NOT EXISTS idx_location_block ON doc_locations(block_id);
+        )";
+
+        for (const char* query : {create_blocks_table, create_locations_table, create_block_index}) {
+            char* errmsg = nullptr;
+            if (sqlite3_exec(db, query, nullptr, nullptr, &errmsg) != SQLITE_OK) {
+                std::cerr << "SQL error: " << errmsg << std::endl;
+                sqlite3_free(errmsg);
+            }
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ append one document to the open block ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto DocumentStore::add(sqlite3* db, long long doc_id, std::string_view text, const std::vector<TokenPosition>& tokens) -> void {
+        size_t start = block.size();
+        uint32_t text_length = static_cast<uint32_t>(text.size());
+        uint32_t token_count = static_cast<uint32_t>(tokens.size());
+
+        block.append(reinterpret_cast<const char*>(&text_length), sizeof(text_length));
+        block.append(reinterpret_cast<const char*>(&token_count), sizeof(token_count));
+        block.append(text);
+        for (const auto& token : tokens) {
+            block.append(reinterpret_cast<const char*>(&token.term_hash), sizeof(token.term_hash));
+            block.append(reinterpret_cast<const char*>(&token.offset), sizeof(token.offset));
+            block.append(reinterpret_cast<const char*>(&token.length), sizeof(token.length));
+        }
+        pending.push_back({doc_id, {start, block.size() - start}});
+
+        if (block.size() >= static_cast<size_t>(index_stream::Config::get().doc_block_bytes))
+            flush(db);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ compress the open block and point its documents at it ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto DocumentStore::flush(sqlite3* db) -> void {
+        if (pending.empty())
+            return;
+
+        uLongf compressed_size = compressBound(static_cast<uLong>(block.size()));
+        std::string compressed(compressed_size, '\0');
+        if (compress2(reinterpret_cast<Bytef*>(compressed.data()), &compressed_size,
+                      reinterpret_cast<const Bytef*>(block.data()), static_cast<uLong>(block.size()), Z_BEST_SPEED) != Z_OK) {
+            std::cerr << "Failed to compress document block" << std::endl;
+            block.clear();
+            pending.clear();
+            return;
+        }
+
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, "INSERT INTO doc_blocks (raw_size, data) VALUES (?, ?);", -1, &stmt, nullptr);
+        sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(block.size()));
+        sqlite3_bind_blob(stmt, 2, compressed.data(), static_cast<int>(compressed_size), SQLITE_STATIC);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+            std::cerr << "Failed to store document block: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_finalize(stmt);
+        long long block_id = sqlite3_last_insert_rowid(db);
+
+        // A re-indexed document simply points at its new copy; the old bytes go with compaction
+        sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO doc_locations (document_id, block_id, offset, length) VALUES (?, ?, ?, ?);", -1, &stmt, nullptr);
+        for (const auto& [doc_id, range] : pending) {
+            sqlite3_reset(stmt);
+            sqlite3_bind_int64(stmt, 1, doc_id);
+            sqlite3_bind_int64(stmt, 2, block_id);
+            sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(range.first));
+            sqlite3_bind_int64(stmt, 4, static_cast<sqlite3_int64>(range.second));
+            if (sqlite3_step(stmt) != SQLITE_DONE)
+                std::cerr << "Failed to store document location: " << sqlite3_errmsg(db) << std::endl;
+        }
+        sqlite3_finalize(stmt);
+
+        block.clear();
+        pending.clear();
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ fetch and decode one stored document ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto DocumentStore::load(ReadConnection& connection, long long doc_id, std::unordered_map<long long, std::string>& block_cache,
+                             std::string_view& text, std::vector<TokenPosition>& tokens) -> bool {
+        static const char* const location_query = "SELECT block_id, offset, length FROM doc_locations WHERE document_id = ?";
+        static const char* const block_query = "SELECT raw_size, data FROM doc_blocks WHERE block_id = ?";
+
+        sqlite3_stmt* stmt = connection.statement(location_query);
+        if (!stmt)
+            return false;
+        sqlite3_bind_int64(stmt, 1, doc_id);
+        if (sqlite3_step(stmt) != SQLITE_ROW) {
+            sqlite3_reset(stmt);
+            return false;
+        }
+        long long block_id = sqlite3_column_int64(stmt, 0);
+        size_t offset = static_cast<size_t>(sqlite3_column_int64(stmt, 1));
+        size_t length = static_cast<size_t>(sqlite3_column_int64(stmt, 2));
+        sqlite3_reset(stmt);
+
+        auto cached = block_cache.find(block_id);
+        if (cached == block_cache.end()) {
+            if (!(stmt = connection.statement(block_query)))
+                return false;
+            sqlite3_bind_int64(stmt, 1, block_id);
+            if (sqlite3_step(stmt) != SQLITE_ROW) {
+                sqlite3_reset(stmt);
+                return false;
+            }
+            uLongf raw_size = static_cast<uLongf>(sqlite3_column_int64(stmt, 0));
+            std::string inflated(raw_size, '\0');
+            int status = uncompress(reinterpret_cast<Bytef*>(inflated.data()), &raw_size,
+                                    static_cast<const Bytef*>(sqlite3_column_blob(stmt, 1)), static_cast<uLong>(sqlite3_column_bytes(stmt, 1)));
+            sqlite3_reset(stmt);
+            if (status != Z_OK)
+                return false;
+            cached = block_cache.emplace(block_id, std::move(inflated)).first;
+        }
+
+        const std::string& data = cached->second;
+        uint32_t text_length, token_count;
+        if (offset + length > data.size() || length < sizeof(text_length) + sizeof(token_count))
+            return false;
+        const char* record = data.data() + offset;
+        std::memcpy(&text_length, record, sizeof(text_length));
+        std::memcpy(&token_count, record + 4, sizeof(token_count));
+        if (8 + static_cast<size_t>(text_length) + static_cast<size_t>(token_count) * 10 > length)
+            return false;
+
+        text = std::string_view(record + 8, text_length);
+        tokens.resize(token_count);
+        const char* entry = record + 8 + text_length;
+        for (auto& token : tokens) {
+            std::memcpy(&token.term_hash, entry, 4);
+            std::memcpy(&token.offset, entry + 4, 4);
+            std::memcpy(&token.length, entry + 8, 2);
+            entry += 10;
+        }
+        return true;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ HTML-escape a slice of stored text ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    static void append_escaped(std::pmr::string& out, std::string_view text) {
+        for (char c : text) {
+            switch (c) {
+                case '&':  out += "&amp;"; break;
+                case '<':  out += "&lt;"; break;
+                case '>':  out += "&gt;"; break;
+                case '"':  out += "&quot;"; break;
+                case '\'': out += "&#39;"; break;
+                default:   out += c;
+            }
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ pick the window with the most distinct query terms and mark them ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto make_snippet(std::string_view text, const std::vector<TokenPosition>& tokens,
+                      const std::vector<uint32_t>& query_hashes, std::pmr::memory_resource* mr) -> std::pmr::string {
+        std::pmr::string snippet(mr);
+        if (tokens.empty())
+            return snippet;
+
+        // Index of the query term each token matches, or -1
+        std::vector<int> match(tokens.size(), -1);
+        for (size_t i = 0; i < tokens.size(); i++) {
+            auto it = std::find(query_hashes.begin(), query_hashes.end(), tokens[i].term_hash);
+            if (it != query_hashes.end())
+                match[i] = static_cast<int>(it - query_hashes.begin());
+        }
+
+        // Sliding window over the token stream: most distinct terms first, then most hits
+        const size_t window = std::min(SNIPPET_TOKENS, tokens.size());
+        std::vector<int> in_window(query_hashes.size(), 0);
+        int distinct = 0, hits = 0, best_distinct = -1, best_hits = -1;
+        size_t best_start = 0;
+        for (size_t i = 0; i < tokens.size(); i++) {
+            if (match[i] >= 0) {
+                hits++;
+                if (in_window[match[i]]++ == 0)
+                    distinct++;
+            }
+            if (i >= window && match[i - window] >= 0) {
+                hits--;
+                if (--in_window[match[i - window]] == 0)
+                    distinct--;
+            }
+            if (i + 1 >= window && (distinct > best_distinct || (distinct == best_distinct && hits > best_hits))) {
+                best_distinct = distinct;
+                best_hits = hits;
+                best_start = i + 1 - window;
+            }
+        }
+
+        size_t last = best_start + window - 1;
+        size_t begin = tokens[best_start].offset;
+        size_t end = std::min(text.size(), static_cast<size_t>(tokens[last].offset) + tokens[last].length);
+
+        snippet.reserve((end - begin) + 64);
+        if (best_start > 0)
+            snippet += "&hellip; ";
+        size_t cursor = begin;
+        for (size_t i = best_start; i <= last; i++) {
+            if (match[i] < 0 || tokens[i].offset < cursor || tokens[i].offset + tokens[i].length > text.size())
+                continue;
+            append_escaped(snippet, text.substr(cursor, tokens[i].offset - cursor));
+            snippet += "<mark>";
+            append_escaped(snippet, text.substr(tokens[i].offset, tokens[i].length));
+            snippet += "</mark>";
+            cursor = tokens[i].offset + tokens[i].length;
+        }
+        if (cursor < end)
+            append_escaped(snippet, text.substr(cursor, end - cursor));
+        if (last + 1 < tokens.size())
+            snippet += " &hellip;";
+        return snippet;
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <memory_resource>
+#include <sqlite3.h>
+
+#include "read_connection.hpp"
+
+namespace indexer {
+
+    // Where an indexed term sits in the stored text: the hash of the analyzed term and the byte
+    // range of its surface form, so snippets never have to re-tokenize a document
+    struct TokenPosition {
+        uint32_t term_hash;
+        uint32_t offset;
+        uint16_t length;
+    };
+
+    uint32_t token_hash(std::string_view analyzed_term);
+
+    // Forward store of parsed document text. Documents are appended to an open block which is
+    // zlib-compressed into doc_blocks once it reaches doc_block_bytes (or the batch commits);
+    // doc_locations maps every document to its block and byte range. Inside a block a document
+    // is [u32 text length][u32 token count][text][token count x (u32 hash, u32 offset, u16 length)],
+    // in host byte order.
+    class DocumentStore {
+    public:
+        static void create_tables(sqlite3* db);
+
+        // Writer side, called under the indexer's ingest lock
+        void add(sqlite3* db, long long doc_id, std::string_view text, const std::vector<TokenPosition>& tokens);
+        void flush(sqlite3* db);
+
+        // Reader side: text and token positions of one document, false if it was never stored.
+        // Decompressed blocks are kept in block_cache for the documents that follow.
+        static bool load(ReadConnection& connection, long long doc_id, std::unordered_map<long long, std::string>& block_cache,
+                         std::string_view& text, std::vector<TokenPosition>& tokens);
+
+    private:
+        std::string block;
+        std::vector<std::pair<long long, std::pair<size_t, size_t>>> pending;  // doc id, (offset, length) in block
+    };
+
+    // Highlighted, HTML-escaped excerpt around the densest window of query terms
+    std::pmr::string make_snippet(std::string_view text, const std::vector<TokenPosition>& tokens,
+                                  const std::vector<uint32_t>& query_hashes, std::pmr::memory_resource* mr);
+}
@@ -0,0 +1,112 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <zlib.h>
+
+#include "dump_segment.hpp"
+#include "config.hpp"
+
+namespace indexer {
+
+    static uint32_t read_u32_le(const unsigned char* p) {
+        return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+    }
+
+    auto is_segment_file(const std::string& file_name) -> bool {
+        return file_name.size() > 4 && file_name.compare(file_name.size() - 4, 4, ".seg") == 0;
+    }
+
+    SegmentReader::~SegmentReader() {
+        if (data)
+            munmap(const_cast<unsigned char*>(data), size);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ map the segment and tell the kernel we read it once, in order ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto SegmentReader::open(const std::string& file_name) -> bool {
+        this->file_name = file_name;
+        int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "Failed to open segment: " << file_name << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        struct stat st {};
+        if (fstat(fd, &st) < 0 || st.st_size == 0) {
+            close(fd);
+            return false;
+        }
+
+        void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            std::cerr << "Failed to map segment: " << file_name << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        data = static_cast<const unsigned char*>(mapped);
+        size = static_cast<size_t>(st.st_size);
+        offset = 0;
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ decode the next intact record, false at the end of the segment ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto SegmentReader::next(std::string& url, std::string& html) -> bool {
+        while (data && offset + SEGMENT_HEADER_SIZE <= size) {
+            const unsigned char* header = data + offset;
+            if (read_u32_le(header) != SEGMENT_MAGIC) {
+                std::cerr << "Bad record magic in " << file_name << " at offset " << offset << ", skipping the rest" << std::endl;
+                return false;
+            }
+
+            uint8_t flags = header[4];
+            size_t url_len = read_u32_le(header + 8);
+            size_t stored_len = read_u32_le(header + 12);
+            size_t raw_len = read_u32_le(header + 16);
+            uint32_t crc = read_u32_le(header + 20);
+
+            const unsigned char* body = header + SEGMENT_HEADER_SIZE;
+            size_t left = size - offset - SEGMENT_HEADER_SIZE;
+            if (url_len > left || stored_len > left - url_len) {
+                std::cerr << "Truncated record in " << file_name << " at offset " << offset << std::endl;
+                return false;
+            }
+            offset += SEGMENT_HEADER_SIZE + url_len + stored_len;
+
+            uLong actual = crc32(0L, Z_NULL, 0);
+            if (flags & SEGMENT_FLAG_HEADER_CRC)
+                actual = crc32(actual, header, static_cast<uInt>(SEGMENT_HEADER_SIZE - 4));
+            actual = crc32(actual, body, static_cast<uInt>(url_len));
+            actual = crc32(actual, body + url_len, static_cast<uInt>(stored_len));
+            if (actual != crc) {
+                corrupt_records++;
+                continue;
+            }
+
+            url.assign(reinterpret_cast<const char*>(body), url_len);
+            if (flags & SEGMENT_FLAG_ZLIB) {
+                // The length is only trusted as far as a page could be that large
+                if (raw_len > static_cast<size_t>(index_stream::Config::get().max_request_bytes)
+                    || raw_len > stored_len * SEGMENT_ZLIB_MAX_RATIO) {
+                    corrupt_records++;
+                    continue;
+                }
+                html.resize(raw_len);
+                uLongf inflated = static_cast<uLongf>(raw_len);
+                if (uncompress(reinterpret_cast<Bytef*>(html.data()), &inflated, body + url_len, static_cast<uLong>(stored_len)) != Z_OK
+                    || inflated != raw_len) {
+                    corrupt_records++;
+                    continue;
+                }
+            } else {
+                html.assign(reinterpret_cast<const char*>(body + url_len), stored_len);
+            }
+            return true;
+        }
+        return false;
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace indexer {
+
+    // Packed dump segments (*.seg): an append-only run of records, each a fixed little-endian
+    // header followed by the URL and the page bytes
+    //
+    //   magic "ISEG" | flags u8 | 3 bytes zero | url_len u32 | stored_len u32 | raw_len u32 | crc32 u32
+    //
+    // The CRC covers the URL and the stored page bytes, preceded by the first 20 header bytes when
+    // flag bit 1 is set (older segments leave it clear). Flag bit 0 means the page is zlib
+    // compressed and inflates to raw_len bytes. Writers append to a .seg.tmp file and rename it
+    // to .seg once it is complete, so readers never see a partial segment.
+    const uint32_t SEGMENT_MAGIC = 0x47455349;  // "ISEG" read as little-endian
+    const uint8_t SEGMENT_FLAG_ZLIB = 0x01;
+    const uint8_t SEGMENT_FLAG_HEADER_CRC = 0x02;
+    const size_t SEGMENT_ZLIB_MAX_RATIO = 1032;  // deflate cannot expand a stream further than this
+    const size_t SEGMENT_HEADER_SIZE = 24;
+
+    bool is_segment_file(const std::string& file_name);
+
+    // Maps a whole segment read-only and walks it front to back. Corrupt records are skipped
+    // while their lengths still fit the file; a bad magic or a truncated tail ends the segment.
+    // A raw_len above max_request_bytes, or beyond what the stored bytes can inflate to, counts
+    // as corrupt before anything is allocated for it.
+    class SegmentReader {
+    public:
+        SegmentReader() = default;
+        ~SegmentReader();
+        SegmentReader(const SegmentReader&) = delete;
+        SegmentReader& operator=(const SegmentReader&) = delete;
+
+        bool open(const std::string& file_name);
+        bool next(std::string& url, std::string& html);
+        size_t corrupt() const { return corrupt_records; }
+
+    private:
+        const unsigned char* data {};
+        size_t size {};
+        size_t offset {};
+        size_t corrupt_records {};
+        std::string file_name;
+    };
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <vector>
+
+#include "fuzzy.hpp"
+#include "config.hpp"
+
+namespace indexer {
+
+    // Longer query terms are not expanded
+    const size_t FUZZY_MAX_TERM = 48;
+
+    // Dictionary rows fetched per seek
+    const int FUZZY_BATCH = 64;
+
+    auto fuzzy_edits(size_t length) -> int {
+        if (length <= 2)
+            return 0;
+        if (length <= 5)
+            return std::min(1, index_stream::Config::get().fuzzy_max_edits);
+        return index_stream::Config::get().fuzzy_max_edits;
+    }
+
+    auto fuzzy_weight(int distance) -> double {
+        return 1.0 / (1.0 + distance);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ smallest key greater than every string starting with prefix ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    static bool prefix_successor(std::string& key) {
+        while (!key.empty()) {
+            unsigned char last = static_cast<unsigned char>(key.back());
+            if (last != 0xff) {
+                key.back() = static_cast<char>(last + 1);
+                return true;
+            }
+            key.pop_back();
+        }
+        return false;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ walk the sorted dictionary with the edit-distance DP ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto fuzzy_expand(ReadConnection& connection, std::string_view term, std::pmr::memory_resource* mr) -> std::pmr::vector<TermMatch> {
+        // LIMIT is FUZZY_BATCH
+        static const char* const from_query = "SELECT term, term_id, document_count FROM terms WHERE term >= ? ORDER BY term LIMIT 64";
+        static const char* const after_query = "SELECT term, term_id, document_count FROM terms WHERE term > ? ORDER BY term LIMIT 64";
+
+        std::pmr::vector<TermMatch> matches(mr);
+        const auto& config = index_stream::Config::get();
+        const int edits = fuzzy_edits(term.size());
+        if (!config.fuzzy || edits == 0 || term.size() > FUZZY_MAX_TERM)
+            return matches;
+
+        const size_t width = term.size() + 1;
+        const std::string prefix(term.substr(0, std::min<size_t>(static_cast<size_t>(std::max(0, config.fuzzy_prefix)), term.size())));
+
+        // rows[i * width + j]: distance between the first i bytes of the current dictionary
+        // term and the first j bytes of the query term
+        std::vector<int> rows((term.size() + edits + 2) * width);
+        for (size_t j = 0; j < width; j++)
+            rows[j] = static_cast<int>(j);
+        std::string previous;  // term the filled rows belong to
+
+        std::string seek = prefix;
+        bool inclusive = true;  // seek is a lower bound, or the last term already visited
+        int scanned = 0;
+        bool done = false;
+        while (!done && scanned < config.fuzzy_max_scan) {
+            sqlite3_stmt* stmt = connection.statement(inclusive ? from_query : after_query);
+            if (!stmt)
+                break;
+            sqlite3_bind_text(stmt, 1, seek.data(), static_cast<int>(seek.size()), SQLITE_TRANSIENT);
+
+            int fetched = 0;
+            bool reseek = false;
+            while (!reseek && scanned < config.fuzzy_max_scan && sqlite3_step(stmt) == SQLITE_ROW) {
+                fetched++;
+                scanned++;
+                std::string_view candidate(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), sqlite3_column_bytes(stmt, 0));
+                if (candidate.compare(0, prefix.size(), prefix) != 0) {
+                    done = true;  // past every term sharing the prefix
+                    break;
+                }
+
+                // A row past term.size() + edits is out of budget on length alone, so at most
+                // that many rows are ever needed
+                size_t length = std::min(candidate.size(), term.size() + edits + 1);
+                size_t common = 0;
+                while (common < length && common < previous.size() && candidate[common] == previous[common])
+                    common++;
+
+                // Extend the rows from the shared prefix, stop at the first row that is out of budget
+                size_t dead = 0;
+                for (size_t i = common + 1; i <= length; i++) {
+                    int* row = &rows[i * width];
+                    const int* above = &rows[(i - 1) * width];
+                    row[0] = static_cast<int>(i);
+                    int best = row[0];
+                    for (size_t j = 1; j < width; j++) {
+                        int substitute = above[j - 1] + (candidate[i - 1] == term[j - 1] ? 0 : 1);
+                        row[j] = std::min({above[j] + 1, row[j - 1] + 1, substitute});
+                        best = std::min(best, row[j]);
+                    }
+                    if (best > edits) {
+                        dead = i;
+                        break;
+                    }
+                }
+
+                if (dead) {
+                    // Nothing under candidate[0, dead) can match, continue after that whole range
+                    previous.assign(candidate.substr(0, dead));
+                    seek = previous;
+                    inclusive = true;
+                    if (!prefix_successor(seek))
+                        done = true;
+                    reseek = true;
+                    break;
+                }
+                previous.assign(candidate);
+
+                int distance = rows[length * width + term.size()];
+                if (distance > 0 && distance <= edits && sqlite3_column_int64(stmt, 2) > 0)
+                    matches.push_back({std::pmr::string(candidate, mr), sqlite3_column_int64(stmt, 1), sqlite3_column_int64(stmt, 2), distance});
+            }
+            if (!reseek && fetched < FUZZY_BATCH)
+                done = true;  // end of the dictionary
+            if (!reseek && !done) {
+                seek = previous;
+                inclusive = false;
+            }
+            sqlite3_reset(stmt);
+        }
+
+        std::sort(matches.begin(), matches.end(), [](const TermMatch& a, const TermMatch& b) {
+            return a.distance != b.distance ? a.distance < b.distance : a.document_count > b.document_count;
+        });
+        if (matches.size() > static_cast<size_t>(config.fuzzy_max_expansions))
+            matches.erase(matches.begin() + config.fuzzy_max_expansions, matches.end());
+        return matches;
+    }
+}
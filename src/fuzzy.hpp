@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <memory_resource>
+
+#include "read_connection.hpp"
+
+namespace indexer {
+
+    // A dictionary term that stands in for a query term, exactly or within a few edits
+    struct TermMatch {
+        std::pmr::string term;
+        long long term_id;
+        long long document_count;
+        int distance;  // Levenshtein distance to the query term, 0 for the exact term
+    };
+
+    // Edits allowed for an analyzed query term of this length: none up to 2 bytes, one up to 5,
+    // then INDEXSTREAM_FUZZY_MAX_EDITS
+    int fuzzy_edits(size_t length);
+
+    // Weight factor of a match: 1 for the exact term, 1 / (1 + distance) for an expansion
+    double fuzzy_weight(int distance);
+
+    // Dictionary terms within fuzzy_edits(term) of term, closest first, then most frequent.
+    // The terms index is walked in sorted order while the Levenshtein DP rows are kept per
+    // prefix, so consecutive terms share their common prefix rows; as soon as every cell of a
+    // row exceeds the edit budget, no term with that prefix can match and the walk seeks past
+    // all of them. Terms must share the first INDEXSTREAM_FUZZY_PREFIX bytes with the query,
+    // and at most INDEXSTREAM_FUZZY_MAX_SCAN dictionary terms are visited, which bounds the cost.
+    std::pmr::vector<TermMatch> fuzzy_expand(ReadConnection& connection, std::string_view term, std::pmr::memory_resource* mr);
+}
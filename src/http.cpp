@@ -1,24 +1,126 @@
+#include <zlib.h>
+#include <strings.h>
+#include <cstdlib>
+
 #include "http.hpp"
+#include "config.hpp"
 
 namespace index_stream {
 
+    // A deflate stream holds about 256 KiB of window and hash tables, so each worker keeps one
+    struct DeflateStream {
+        z_stream stream {};
+        bool ready {};
+
+        DeflateStream() {
+            // windowBits 15 + 16 writes a gzip header and trailer instead of a zlib one
+            ready = deflateInit2(&stream, Config::get().gzip_level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        }
+
+        ~DeflateStream() {
+            if (ready)
+                deflateEnd(&stream);
+        }
+    };
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ gzip a body with this thread's deflate stream ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto gzip_compress(std::string_view data, std::pmr::string& out) -> bool {
+        thread_local DeflateStream deflater;
+        z_stream& stream = deflater.stream;
+        if (!deflater.ready || deflateReset(&stream) != Z_OK)
+            return false;
+
+        // deflateBound covers the whole output, so one Z_FINISH call always completes
+        out.resize(deflateBound(&stream, data.size()));
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        stream.avail_in = static_cast<uInt>(data.size());
+        stream.next_out = reinterpret_cast<Bytef*>(out.data());
+        stream.avail_out = static_cast<uInt>(out.size());
+        if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+            return false;
+        out.resize(stream.total_out);
+        return true;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ check Accept-Encoding for gzip ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // An explicit gzip entry decides on its own, whatever its position; "*" only covers gzip
+    // when gzip is not named
+    auto accepts_gzip(const HTTPRequest& req) -> bool {
+        auto trim = [](std::string_view s) {
+            while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+            while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+            return s;
+        };
+
+        double gzip_quality = -1.0, any_quality = -1.0;  // -1 = not listed
+        for (const auto& [name, value] : req.headers) {
+            if (strcasecmp(name.c_str(), "Accept-Encoding") != 0)
+                continue;
+
+            // e.g. "gzip, deflate, br;q=0.8"
+            std::string_view rest = value;
+            while (!rest.empty()) {
+                size_t comma = rest.find(',');
+                std::string_view coding = rest.substr(0, comma);
+                rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+
+                size_t semicolon = coding.find(';');
+                std::string_view token = trim(coding.substr(0, semicolon));
+                double quality = 1.0;
+                if (semicolon != std::string_view::npos) {
+                    std::string_view params = trim(coding.substr(semicolon + 1));
+                    if (params.size() >= 2 && (params[0] == 'q' || params[0] == 'Q') && params[1] == '=')
+                        quality = std::atof(std::string(trim(params.substr(2))).c_str());
+                }
+
+                if (token.size() == 4 && strncasecmp(token.data(), "gzip", 4) == 0)
+                    gzip_quality = quality;
+                else if (token == "*")
+                    any_quality = quality;
+            }
+        }
+        return gzip_quality >= 0.0 ? gzip_quality > 0.0 : any_quality > 0.0;
+    }
 
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Generate HTTP response string ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
-    std::string HTTPResponse::generate_response() const {
-        std::ostringstream response {};
-        response << "HTTP/1.1 " << status_code << " " << status_message << "\r\n";
-        response << "Content-Type: " << content_type << "\r\n";
+    std::pmr::string HTTPResponse::generate_response() const {
+        // Compress only bodies worth it, and keep the original if gzip did not make it smaller
+        const size_t gzip_min_bytes = static_cast<size_t>(Config::get().gzip_min_bytes);
+        bool varies = gzip_min_bytes > 0 && body.length() >= gzip_min_bytes;
+        std::pmr::string compressed(body.get_allocator());
+        bool gzipped = varies && gzip && gzip_compress(body, compressed) && compressed.length() < body.length();
+        const std::pmr::string& payload = gzipped ? compressed : body;
+
+        std::pmr::string response(body.get_allocator());
+        response.reserve(payload.length() + 256);
+
+        response.append("HTTP/1.1 ").append(std::to_string(status_code)).append(" ").append(status_message).append("\r\n");
+        response.append("Content-Type: ").append(content_type).append("\r\n");
 
         if (!this->location.empty())
-            response << "Location: " << location << "\r\n";
+            response.append("Location: ").append(location).append("\r\n");
 
         if (!this->cookies.first.empty() && !this->cookies.first.empty())
-            response << "Set-Cookie: " << cookies.first << "=" << cookies.second << "; SameSite=None; Secure; HttpOnly\r\n";
+            response.append("Set-Cookie: ").append(cookies.first).append("=").append(cookies.second).append("; SameSite=None; Secure; HttpOnly\r\n");
+
+        for (const auto& [name, value] : headers)
+            response.append(name).append(": ").append(value).append("\r\n");
+
+        if (gzipped)
+            response.append("Content-Encoding: gzip\r\n");
+        if (varies)
+            response.append("Vary: Accept-Encoding\r\n");
+
+        response.append("Content-Length: ").append(std::to_string(payload.length())).append("\r\n");
+        response.append("\r\n");
+        response.append(payload);
+        return response;
+    }
 
-        response << "Content-Length: " << body.length() << "\r\n";
-        response << "\r\n";
-        response << body;
-        return response.str();
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Set a JSON body ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    void HTTPResponse::set_JSON_content(const std::string& json_data) {
+        content_type = "application/json";
+        body = json_data;
     }
 
-}
\ No newline at end of file
+}
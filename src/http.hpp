@@ -1,34 +1,61 @@
 #include <vector>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <memory_resource>
 
 #ifndef RFSS_HTTP_HPP
 #define RFSS_HTTP_HPP
 
 namespace index_stream {
 
+    using header_list = std::pmr::vector<std::pair<std::pmr::string, std::pmr::string>>;
+    using query_map = std::pmr::unordered_map<std::pmr::string, std::pmr::string>;
+
     struct HTTPResponse {
         int status_code {};
-        std::string status_message {};
-        std::string content_type = "text/plain";
-        std::string body {};
-        std::string location {};
+        std::pmr::string status_message;
+        std::pmr::string content_type;
+        std::pmr::string body;
+        std::pmr::string location;
         std::pair<std::string, std::string> cookies {};
-        std::string generate_response() const;
+        header_list headers;  // extra headers, e.g. Retry-After
+        bool gzip {};         // client accepts gzip (see accepts_gzip), large bodies go out compressed
+
+        explicit HTTPResponse(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+            : status_message(mr), content_type("text/plain", mr), body(mr), location(mr), headers(mr) {}
+
+        std::pmr::string generate_response() const;
         void set_JSON_content(const std::string& json_data);
     };
 
+    // Every member draws from the memory resource handed in, so a request parsed inside an
+    // ArenaScope lives entirely in that thread's arena
     struct HTTPRequest {
-        std::string method   {};
-        std::string URI      {};
-        std::string version  {};
-        std::string multipart_boundary {};
-        std::vector<std::pair<std::string, std::string>> headers {};
-        std::vector<std::pair<std::string, std::string>> cookies {};
-        std::string body     {};
+        std::pmr::string method;
+        std::pmr::string URI;
+        std::pmr::string version;
+        std::pmr::string multipart_boundary;
+        header_list headers;
+        header_list cookies;
+        std::pmr::string body;
+
+        explicit HTTPRequest(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+            : method(mr), URI(mr), version(mr), multipart_boundary(mr),
+              headers(mr), cookies(mr), body(mr) {}
+
+        std::pmr::memory_resource* resource() const { return body.get_allocator().resource(); }
     };
 
+    // Whether the request's Accept-Encoding allows gzip; "gzip;q=0" rules it out
+    bool accepts_gzip(const HTTPRequest& req);
+
+    // Gzips data into out with the calling thread's deflate stream, which is reset rather than
+    // set up again for every response. Returns false if zlib failed.
+    bool gzip_compress(std::string_view data, std::pmr::string& out);
+
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,121 @@
+#include <sys/socket.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include "http_client.hpp"
+
+namespace index_stream {
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ wait for the socket until the deadline, false on timeout ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    static bool wait_socket(int fd, short events, std::chrono::steady_clock::time_point deadline) {
+        for (;;) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (left <= 0)
+                return false;
+            pollfd pfd {fd, events, 0};
+            int ready = poll(&pfd, 1, static_cast<int>(left));
+            if (ready > 0)
+                return true;
+            if (ready < 0 && errno != EINTR)
+                return false;
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ non-blocking connect bounded by the deadline ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    static int connect_to(const std::string& host, int port, std::chrono::steady_clock::time_point deadline) {
+        addrinfo hints {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+            return -1;
+
+        int fd = -1;
+        for (addrinfo* address = addresses; address; address = address->ai_next) {
+            fd = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+            if (fd < 0)
+                continue;
+
+            if (connect(fd, address->ai_addr, address->ai_addrlen) == 0)
+                break;
+            if (errno == EINPROGRESS && wait_socket(fd, POLLOUT, deadline)) {
+                int error = 0;
+                socklen_t length = sizeof(error);
+                if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0)
+                    break;
+            }
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(addresses);
+        return fd;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ send one GET and read the response until the server closes ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto http_get(const std::string& host, int port, const std::string& path,
+                  std::chrono::steady_clock::time_point deadline, std::string& body) -> int {
+        int fd = connect_to(host, port, deadline);
+        if (fd < 0)
+            return 0;
+
+        std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: close\r\n\r\n";
+        size_t sent = 0;
+        while (sent < request.size()) {
+            ssize_t n = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                sent += static_cast<size_t>(n);
+            } else if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+                if (!wait_socket(fd, POLLOUT, deadline)) {
+                    close(fd);
+                    return 0;
+                }
+            } else {
+                close(fd);
+                return 0;
+            }
+        }
+
+        std::string response;
+        char buffer[16384];
+        size_t header_end = std::string::npos;
+        size_t content_length = std::string::npos;
+        for (;;) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                response.append(buffer, static_cast<size_t>(n));
+                if (header_end == std::string::npos && (header_end = response.find("\r\n\r\n")) != std::string::npos) {
+                    size_t pos = response.find("Content-Length:");
+                    if (pos != std::string::npos && pos < header_end)
+                        content_length = std::strtoull(response.c_str() + pos + 15, nullptr, 10);
+                }
+                if (header_end != std::string::npos && content_length != std::string::npos
+                    && response.size() >= header_end + 4 + content_length)
+                    break;
+            } else if (n == 0) {
+                break;
+            } else if (errno == EAGAIN || errno == EINTR) {
+                if (!wait_socket(fd, POLLIN, deadline)) {
+                    close(fd);
+                    return 0;
+                }
+            } else {
+                close(fd);
+                return 0;
+            }
+        }
+        close(fd);
+
+        // "HTTP/1.1 200 OK"
+        if (header_end == std::string::npos || response.compare(0, 5, "HTTP/") != 0)
+            return 0;
+        size_t space = response.find(' ');
+        int status = space == std::string::npos ? 0 : std::atoi(response.c_str() + space + 1);
+        body = response.substr(header_end + 4, content_length == std::string::npos ? std::string::npos : content_length);
+        return status;
+    }
+}
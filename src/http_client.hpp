@@ -0,0 +1,16 @@
+#include <string>
+#include <chrono>
+
+#ifndef RFSS_HTTP_CLIENT_HPP
+#define RFSS_HTTP_CLIENT_HPP
+
+namespace index_stream {
+
+    // Minimal blocking HTTP/1.1 GET used for talking to shard servers. Every step (connect,
+    // send, receive) is bounded by the deadline. Returns the status code with the body filled
+    // in, or 0 if the shard could not be reached or did not answer in time.
+    int http_get(const std::string& host, int port, const std::string& path,
+                 std::chrono::steady_clock::time_point deadline, std::string& body);
+}
+
+#endif
@@ -7,63 +7,70 @@ namespace index_stream {
 
 
     // ~~~~~~~~~~~~~~~~~~~~~~~ Helper Function to trim white spaces from strings ~~~~~~~~~~~~~~~~~~~~~~~
-    std::string trim(const std::string& str) {
+    std::string_view trim(std::string_view str) {
         auto start = str.find_first_not_of(" \t\n\r\f\v");
         
-        if (start == std::string::npos) {
-            return ""; 
+        if (start == std::string_view::npos) {
+            return {}; 
         }
 
         auto end = str.find_last_not_of(" \t\n\r\f\v");
         return str.substr(start, end - start + 1);
     }
 
+    // ~~~~~~~~~~~~~~~~~~~~~~~ Helper to pop the next delimited field off a view ~~~~~~~~~~~~~~~~~~~~~~~
+    static std::string_view next_field(std::string_view& rest, char delim) {
+        size_t pos = rest.find(delim);
+        std::string_view field = rest.substr(0, pos);
+        rest = (pos == std::string_view::npos) ? std::string_view{} : rest.substr(pos + 1);
+        return field;
+    }
+
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Function to parse form data incoming with request ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
-    auto parse_form_data(const std::string& form_data, HTTPRequest& req) -> void {
-        std::istringstream iss(form_data);
-        std::string pair;
-        while (std::getline(iss, pair, '&')) {
+    auto parse_form_data(std::string_view form_data, HTTPRequest& req) -> void {
+        while (!form_data.empty()) {
+            std::string_view pair = next_field(form_data, '&');
             size_t pos = pair.find('=');
-            if (pos != std::string::npos) {
-                std::string key = pair.substr(0, pos);
-                std::string value = pair.substr(pos + 1);
-                key = url_decode(key);
-                value = url_decode(value);
-                req.body.append(key + ": " + value + "\n");
+            if (pos != std::string_view::npos) {
+                req.body.append(url_decode(pair.substr(0, pos), req.resource()));
+                req.body.append(": ");
+                req.body.append(url_decode(pair.substr(pos + 1), req.resource()));
+                req.body.append("\n");
             }
         }
     }
 
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Function to parse header data from incoming request ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
-    void parse_headers(HTTPRequest& req, const std::string& header_str) {
-        std::istringstream iss(header_str);
-        std::string line;
-
-        std::getline(iss, line);
-        std::istringstream line_stream(line);
-        line_stream >> req.method >> req.URI >> req.version;
-        req.method = trim(req.method);
-        req.URI = trim(req.URI);
-        req.version = trim(req.version);
-
-        while (std::getline(iss, line) && line != "\r") {
-            if (line.back() == '\r') {
-                line.pop_back(); 
+    void parse_headers(HTTPRequest& req, std::string_view header_str) {
+        std::string_view request_line = next_field(header_str, '\n');
+        if (!request_line.empty() && request_line.back() == '\r')
+            request_line.remove_suffix(1);
+
+        request_line = trim(request_line);
+        req.method = trim(next_field(request_line, ' '));
+        request_line = trim(request_line);
+        req.URI = trim(next_field(request_line, ' '));
+        req.version = trim(request_line);
+
+        while (!header_str.empty()) {
+            std::string_view line = next_field(header_str, '\n');
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1); 
             }
+            if (line.empty())
+                break;
+
             size_t pos = line.find(':');
-            if (pos != std::string::npos) {
-                std::string key = trim(line.substr(0, pos));
-                std::string value = trim(line.substr(pos + 1));
+            if (pos != std::string_view::npos) {
+                std::string_view key = trim(line.substr(0, pos));
+                std::string_view value = trim(line.substr(pos + 1));
 
                 if (key == "Cookie") {
-                    std::istringstream cookie_stream(value);
-                    std::string cookie_pair;
-                    while (std::getline(cookie_stream, cookie_pair, ';')) {
+                    while (!value.empty()) {
+                        std::string_view cookie_pair = next_field(value, ';');
                         size_t eq_pos = cookie_pair.find('=');
-                        if (eq_pos != std::string::npos) {
-                            std::string cookie_name = trim(cookie_pair.substr(0, eq_pos));
-                            std::string cookie_value = trim(cookie_pair.substr(eq_pos + 1));
-                            req.cookies.emplace_back(cookie_name, cookie_value);
+                        if (eq_pos != std::string_view::npos) {
+                            req.cookies.emplace_back(trim(cookie_pair.substr(0, eq_pos)), trim(cookie_pair.substr(eq_pos + 1)));
                         }
                     }
                 } else {
@@ -74,22 +81,22 @@ namespace index_stream {
     }
 
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Function to parse body data from incoming request ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
-    void parse_body(HTTPRequest& req, const std::string& body_content) {
+    void parse_body(HTTPRequest& req, std::string_view body_content) {
         bool is_form_data = false;
         bool is_multipart_data = false;
 
         for (const auto& header : req.headers) {
             if (header.first == "Content-Type") {
-                if (header.second.find("application/x-www-form-urlencoded") != std::string::npos) {
+                if (header.second.find("application/x-www-form-urlencoded") != std::pmr::string::npos) {
                     is_form_data = true;
-                } else if (header.second.find("multipart/form-data") != std::string::npos) {
+                } else if (header.second.find("multipart/form-data") != std::pmr::string::npos) {
                     is_multipart_data = true;
-                    const std::string boundaryPrefix = "boundary=";
+                    const std::string_view boundaryPrefix = "boundary=";
                     size_t pos = header.second.find(boundaryPrefix);
-                    if (pos != std::string::npos) {
+                    if (pos != std::pmr::string::npos) {
                         size_t start = pos + boundaryPrefix.length();
                         size_t end = header.second.find(';', start);
-                        if (end == std::string::npos) {
+                        if (end == std::pmr::string::npos) {
                             end = header.second.length();
                         }
                         req.multipart_boundary = header.second.substr(start, end - start);
@@ -106,48 +113,84 @@ namespace index_stream {
         }
     }
 
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Function to turn a connection away with 503 without parsing it ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    void reject_client(int client_socket, int retry_after) {
+        // Drain what already arrived so closing does not reset the connection before the
+        // client has read the response
+        char buffer[BUFFER_SIZE];
+        while (recv(client_socket, buffer, BUFFER_SIZE, MSG_DONTWAIT) > 0) {}
+
+        HTTPResponse response;
+        response.status_code = 503;
+        response.status_message = "Service Unavailable";
+        response.headers.emplace_back("Retry-After", std::to_string(retry_after));
+        std::pmr::string http_response = response.generate_response();
+        send(client_socket, http_response.c_str(), http_response.length(), MSG_NOSIGNAL);
+        shutdown(client_socket, SHUT_WR);
+        close(client_socket);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Function to tell bulk requests from interactive ones ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // Ingest bodies can be tens of megabytes and deletes wait for the indexer's write lock
+    bool is_bulk_request(const HTTPRequest& req) {
+        return req.method == "POST" || req.method == "DELETE";
+    }
+
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Function to parse incoming requests ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
-    void handle_client(int client_socket) {
+    std::optional<std::string> handle_client(int client_socket, bool defer_bulk, std::string_view received) {
+        // Every allocation made while serving this connection comes out of the worker's arena
+        // and is dropped in one go when the scope ends
+        ArenaScope arena;
         char buffer[BUFFER_SIZE];
-        HTTPRequest request;
-        std::string http_request_string;
+        HTTPRequest request(arena.resource());
+        std::pmr::string http_request_string(received, arena.resource());
         bool headers_received = false;
         size_t content_length = 0;
 
         auto start_time = std::chrono::steady_clock::now();
 
         while (true) {
-            ssize_t bytes_read = recv(client_socket, buffer, BUFFER_SIZE, 0);
-            if (bytes_read <= 0) {
-                if (bytes_read < 0) {
-                    std::cerr << "Error: Client disconnected or no data received!\n";
-                }
-                close(client_socket);
-                return;
-            }
-
-            http_request_string.append(buffer, bytes_read);
-
             if (!headers_received) {
                 size_t pos = http_request_string.find("\r\n\r\n");
-                if (pos != std::string::npos) {
+                if (pos != std::pmr::string::npos) {
                     headers_received = true;
-                    std::string header_str = http_request_string.substr(0, pos);
-                    parse_headers(request, header_str);
+                    parse_headers(request, std::string_view(http_request_string).substr(0, pos));
                     
                     for (const auto& header : request.headers) {
                         if (header.first == "Content-Length") {
-                            content_length = std::stoi(header.second);
+                            content_length = std::strtoull(header.second.c_str(), nullptr, 10);
                             break;
                         }
                     }
+
+                    // Refuse oversized bodies before buffering them
+                    // Like reject_client: drain what arrived so the close does not reset the
+                    // connection before the client reads the 413, and never raise SIGPIPE on a
+                    // client that already hung up
+                    if (content_length > static_cast<size_t>(Config::get().max_request_bytes)) {
+                        while (recv(client_socket, buffer, BUFFER_SIZE, MSG_DONTWAIT) > 0) {}
+
+                        HTTPResponse response(arena.resource());
+                        response.status_code = 413;
+                        response.status_message = "Payload Too Large";
+                        std::pmr::string http_response = response.generate_response();
+                        send(client_socket, http_response.c_str(), http_response.length(), MSG_NOSIGNAL);
+                        shutdown(client_socket, SHUT_WR);
+                        close(client_socket);
+                        return std::nullopt;
+                    }
+
+                    // Hand bulk work back before reading its body, with everything read so far
+                    if (defer_bulk && is_bulk_request(request))
+                        return std::string(http_request_string);
                     
                     http_request_string.erase(0, pos + 4); 
+                    http_request_string.reserve(content_length);
                 }
             }
 
             if (headers_received && http_request_string.size() >= content_length) {
-                parse_body(request, http_request_string.substr(0, content_length));
+                parse_body(request, std::string_view(http_request_string).substr(0, content_length));
                 break;
             }
 
@@ -156,10 +199,22 @@ namespace index_stream {
             if (elapsed_time > 30) {
                 std::cerr << "Error: Timeout while reading from client socket\n";
                 close(client_socket);
-                return;
+                return std::nullopt;
+            }
+
+            ssize_t bytes_read = recv(client_socket, buffer, BUFFER_SIZE, 0);
+            if (bytes_read <= 0) {
+                if (bytes_read < 0) {
+                    std::cerr << "Error: Client disconnected or no data received!\n";
+                }
+                close(client_socket);
+                return std::nullopt;
             }
+
+            http_request_string.append(buffer, bytes_read);
         }
         handle_request(request, client_socket);
         close(client_socket);
+        return std::nullopt;
     }
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include <string>
+#include <string_view>
 #include <vector>
 #include <sstream>
 #include <iomanip>
@@ -6,24 +7,33 @@
 #include <iostream>
 #include <sys/socket.h>
 #include <unordered_map>
+#include <memory_resource>
 #include <chrono>
+#include <optional>
 
 
+#include "arena.hpp"
+#include "config.hpp"
 #include "http_request_handler.hpp"
 
 #ifndef RFSS_HTTP_PARSER_HPP
 #define RFSS_HTTP_PARSER_HPP
 
 namespace index_stream {
-    
-    void handle_client(int client_socket);
-    void parse_headers(HTTPRequest& req, const std::string& req_str);
-    void parse_body(HTTPRequest& req, const std::string& req_str);
-    void parse_form_data(const std::string& form_data, HTTPRequest& req);
+
+    // Reads one request and serves it. With defer_bulk set, a bulk request (see is_bulk_request)
+    // is not served: the bytes read so far are returned so the caller can requeue the connection
+    // on the bulk lane and call again with them as `received`.
+    std::optional<std::string> handle_client(int client_socket, bool defer_bulk = false, std::string_view received = {});
+    bool is_bulk_request(const HTTPRequest& req);
+    void reject_client(int client_socket, int retry_after);
+    void parse_headers(HTTPRequest& req, std::string_view req_str);
+    void parse_body(HTTPRequest& req, std::string_view req_str);
+    void parse_form_data(std::string_view form_data, HTTPRequest& req);
 
     // Helper functions
-    std::string trim(const std::string& str);
-    void parse_query_params(const std::string& query, std::unordered_map<std::string, std::string>& query_params);
+    std::string_view trim(std::string_view str);
+    void parse_query_params(std::string_view query, query_map& query_params);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -4,9 +4,21 @@ namespace index_stream {
 
 
     auto handle_request(HTTPRequest& req, int client_socket) -> void {
+        std::string_view path = std::string_view(req.URI).substr(0, req.URI.find('?'));
+
         if (req.method == "GET") {
-            if (req.URI == "/")     handle_get_home(req, client_socket);
-            if (req.URI.find("/search") != std::string::npos)   handle_get_search(req, client_socket);
+            if (path == "/")     handle_get_home(req, client_socket);
+            if (path == "/search")   handle_get_search(req, client_socket);
+            if (path == "/api/search")   handle_get_api_search(req, client_socket);
+            if (path == "/api/shard/stats")   handle_get_shard_stats(req, client_socket);
+            if (path == "/api/shard/search")   handle_get_shard_search(req, client_socket);
+            if (path == "/api/status")   handle_get_api_status(req, client_socket);
+        }
+        if (req.method == "POST") {
+            if (path == "/ingest")   handle_post_ingest(req, client_socket);
+        }
+        if (req.method == "DELETE") {
+            if (path == "/document")   handle_delete_document(req, client_socket);
         }
     }
 }
\ No newline at end of file
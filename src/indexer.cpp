@@ -35,6 +35,11 @@ namespace indexer {
         }
         std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
         file.close();
+        parse_html(std::move(content), document);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Strip the html tags from a page already in memory ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::parse_html(std::string content, std::string& document) -> void {
         std::regex scriptStyleRegex("<(script|style)[^>]*>[\\s\\S]*?</\\1>", std::regex::icase);
         content = std::regex_replace(content, scriptStyleRegex, "");
         std::regex bodyRegex("<body[^>]*>([\\s\\S]*?)</body>", std::regex::icase);
@@ -59,9 +64,6 @@ namespace indexer {
 
             std::regex whitespaceRegex("\\s+");
             document = std::regex_replace(document, whitespaceRegex, " ");
-            std::transform(document.begin(), document.end(), document.begin(), [](unsigned char c) {
-                return std::tolower(c);
-            });
         }
     }
 
@@ -119,6 +121,22 @@ namespace indexer {
         }
     }
 
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ WAL lets searches read while a batch is being written ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::configure_connection(sqlite3* db) -> void {
+        sqlite3_exec(db, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr);
+        sqlite3_exec(db, "PRAGMA synchronous=NORMAL;", nullptr, nullptr, nullptr);
+        sqlite3_busy_timeout(db, 5000);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ read-only connection of the calling worker thread ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::reader() -> ReadConnection& {
+        thread_local ReadConnection connection;
+        long long generation = db_generation.load(std::memory_order_acquire);
+        if (connection.generation() != generation)
+            connection.open(db_path, generation);
+        return connection;
+    }
+
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Create tables if they dont exist ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
     auto Indexer::create_tables() -> void {
 
@@ -139,18 +157,6 @@ namespace indexer {
             );
         )";
 
-        const char* create_matrix_table = R"(
-            CREATE TABLE IF NOT EXISTS term_document_matrix (
-                term_id INTEGER,
-                document_id INTEGER,
-                frequency INTEGER, -- Number of occurrences of the term in the document (TF numerator)
-                tf_idf REAL DEFAULT 0.0, -- Precomputed TF_IDF value
-                PRIMARY KEY (term_id, document_id),
-                FOREIGN KEY (term_id) REFERENCES terms(term_id),
-                FOREIGN KEY (document_id) REFERENCES documents(document_id)
-            );
-        )";
-
         const char* create_stats_table = R"(
             CREATE TABLE IF NOT EXISTS stats (
                 total_documents INTEGER DEFAULT 0  -- Total number of documents in the entire corpus
@@ -161,16 +167,32 @@ namespace indexer {
             CREATE INDEX IF NOT EXISTS idx_term ON terms(term);
         )";
 
-        const char* create_tdm_index = R"(
-            CREATE INDEX IF NOT EXISTS idx_term_document ON term_document_matrix(term_id, document_id);
-        )";
-
         execute_sql(create_terms_table);
         execute_sql(create_documents_table);
-        execute_sql(create_matrix_table);
         execute_sql(create_stats_table);
+        const char* create_tombstones_table = R"(
+            CREATE TABLE IF NOT EXISTS tombstones (
+                document_id INTEGER PRIMARY KEY -- deleted document whose postings have not been compacted yet
+            );
+        )";
+
+        const char* create_aliases_table = R"(
+            CREATE TABLE IF NOT EXISTS document_aliases (
+                alias TEXT PRIMARY KEY, -- URL collapsed into an indexed near-duplicate
+                document_id INTEGER,
+                FOREIGN KEY (document_id) REFERENCES documents(document_id)
+            );
+        )";
+
         execute_sql(create_term_index);
-        execute_sql(create_tdm_index);
+        execute_sql(create_aliases_table);
+        execute_sql(create_tombstones_table);
+        PostingStore::create_tables(safe_check_cpy() ? temp_db_ : db_);
+        DocumentStore::create_tables(safe_check_cpy() ? temp_db_ : db_);
+        create_link_table(safe_check_cpy() ? temp_db_ : db_);
+        add_column_if_missing("documents", "simhash", "INTEGER DEFAULT 0");  // SimHash fingerprint of the indexed terms
+        add_column_if_missing("documents", "static_rank", "REAL DEFAULT 1");  // PageRank scaled to a corpus mean of 1
+        migrate_schema();
 
         const char* init_stats_table = R"(
             INSERT INTO stats (total_documents) VALUES (0);
@@ -179,23 +201,174 @@ namespace indexer {
 
     }
 
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ one-off data migrations, tracked in PRAGMA user_version ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::migrate_schema() -> void {
+        sqlite3* db = safe_check_cpy() ? temp_db_ : db_;
+        sqlite3_stmt* stmt;
+        int version = 0;
+
+        if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+            version = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+
+        // Stores created from v2 on never had the row-per-posting table
+        bool row_postings = false;
+        if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'term_document_matrix';", -1, &stmt, nullptr) == SQLITE_OK)
+            row_postings = sqlite3_step(stmt) == SQLITE_ROW;
+        sqlite3_finalize(stmt);
+
+        if (version < 1 && row_postings) {
+            // document_count used to stay at 0, it is maintained incrementally from here on
+            std::cout << "Migrating schema to v1: recounting term document frequencies...\n";
+            execute_sql(R"(
+                UPDATE terms SET document_count = (
+                    SELECT COUNT(*) FROM term_document_matrix td WHERE td.term_id = terms.term_id
+                );
+            )");
+        }
+        if (version < 2 && row_postings) {
+            std::cout << "Migrating schema to v2: packing postings into one list per term...\n";
+            migrate_row_postings();
+        }
+        if (version < 3) {
+            // v2 kept each list in a single row that every flush rewrote
+            bool list_postings = false;
+            if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'postings';", -1, &stmt, nullptr) == SQLITE_OK)
+                list_postings = sqlite3_step(stmt) == SQLITE_ROW;
+            sqlite3_finalize(stmt);
+            if (list_postings) {
+                std::cout << "Migrating schema to v3: moving posting lists into segments...\n";
+                migrate_list_segments();
+            }
+            execute_sql("PRAGMA user_version = 3;");
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ v2: term_document_matrix rows -> per-term posting lists ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // Both passes stream the old table in key order, so only one list (or one document's terms)
+    // is held in memory at a time. The old table and its two indexes are dropped at the end;
+    // the freed pages are reused by later writes rather than returned to the filesystem.
+    auto Indexer::migrate_row_postings() -> void {
+        sqlite3* db = safe_check_cpy() ? temp_db_ : db_;
+        sqlite3_stmt* stmt;
+        sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+
+        const char* list_query = R"(
+            SELECT td.term_id, td.document_id, td.frequency, COALESCE(d.total_terms, 0)
+            FROM term_document_matrix td
+            JOIN documents d ON d.document_id = td.document_id
+            ORDER BY td.term_id, td.document_id;
+        )";
+        long long lists = 0, current_term = 0;
+        std::vector<Posting> list;
+        if (sqlite3_prepare_v2(db, list_query, -1, &stmt, nullptr) == SQLITE_OK) {
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                long long term_id = sqlite3_column_int64(stmt, 0);
+                if (term_id != current_term && !list.empty()) {
+                    PostingStore::write_list(db, current_term, list);
+                    list.clear();
+                    lists++;
+                }
+                current_term = term_id;
+                list.push_back({sqlite3_column_int64(stmt, 1), static_cast<uint32_t>(sqlite3_column_int64(stmt, 2)),
+                                  static_cast<uint32_t>(sqlite3_column_int64(stmt, 3))});
+            }
+        }
+        sqlite3_finalize(stmt);
+        if (!list.empty()) {
+            PostingStore::write_list(db, current_term, list);
+            lists++;
+        }
+
+        long long current_document = 0;
+        std::vector<long long> term_ids;
+        if (sqlite3_prepare_v2(db, "SELECT document_id, term_id FROM term_document_matrix ORDER BY document_id, term_id;", -1, &stmt, nullptr) == SQLITE_OK) {
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                long long doc_id = sqlite3_column_int64(stmt, 0);
+                if (doc_id != current_document && !term_ids.empty()) {
+                    PostingStore::write_document_terms(db, current_document, std::move(term_ids));
+                    term_ids.clear();
+                }
+                current_document = doc_id;
+                term_ids.push_back(sqlite3_column_int64(stmt, 1));
+            }
+        }
+        sqlite3_finalize(stmt);
+        if (!term_ids.empty())
+            PostingStore::write_document_terms(db, current_document, std::move(term_ids));
+
+        execute_sql("DROP TABLE term_document_matrix;");
+        sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+        std::cout << "Packed " << lists << " posting lists" << std::endl;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ v3: single-row posting lists -> first generation of their segments ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // A v2 list BLOB has the segment layout already, so it is copied as it is, one row at a time
+    auto Indexer::migrate_list_segments() -> void {
+        sqlite3* db = safe_check_cpy() ? temp_db_ : db_;
+        sqlite3_stmt* stmt;
+        sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+
+        long long lists = 0;
+        if (sqlite3_prepare_v2(db, "SELECT term_id, data FROM postings;", -1, &stmt, nullptr) == SQLITE_OK) {
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                PostingStore::import_list(db, sqlite3_column_int64(stmt, 0),
+                                          std::string_view(static_cast<const char*>(sqlite3_column_blob(stmt, 1)), sqlite3_column_bytes(stmt, 1)));
+                lists++;
+            }
+        }
+        sqlite3_finalize(stmt);
+
+        execute_sql("DROP TABLE postings;");
+        sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+        std::cout << "Moved " << lists << " posting lists" << std::endl;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ add a column to a table created by an older schema ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::add_column_if_missing(const char* table, const char* column, const char* definition) -> void {
+        sqlite3* db = safe_check_cpy() ? temp_db_ : db_;
+        sqlite3_stmt* stmt;
+        std::string pragma = std::string("PRAGMA table_info(") + table + ");";
+        bool exists = false;
+
+        if (sqlite3_prepare_v2(db, pragma.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                if (std::string_view(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1))) == column) {
+                    exists = true;
+                    break;
+                }
+            }
+        }
+        sqlite3_finalize(stmt);
+
+        if (!exists) {
+            std::string alter = std::string("ALTER TABLE ") + table + " ADD COLUMN " + column + " " + definition + ";";
+            execute_sql(alter.c_str());
+        }
+    }
+
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ insert term in db if it doesnt exist and return the term id ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
-    auto Indexer::get_or_insert_term(const std::string& term) -> long long {
+    auto Indexer::get_or_insert_term(std::string_view term, uint64_t hash) -> long long {
+        if (long long cached = term_dictionary.find(term, hash))
+            return cached;
+
         sqlite3_stmt* stmt;
         // Insert the term if it doesn't exist
         sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, "INSERT OR IGNORE INTO terms (term, document_count) VALUES (?, 0);", -1, &stmt, nullptr);
-        sqlite3_bind_text(stmt, 1, term.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 1, term.data(), static_cast<int>(term.size()), SQLITE_STATIC);
         sqlite3_step(stmt);
         sqlite3_finalize(stmt);
 
         // Select the term_id and document_count
         sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, "SELECT term_id, document_count FROM terms WHERE term = ?;", -1, &stmt, nullptr);
-        sqlite3_bind_text(stmt, 1, term.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 1, term.data(), static_cast<int>(term.size()), SQLITE_STATIC);
         sqlite3_step(stmt);
         long long term_id = sqlite3_column_int64(stmt, 0);
         long long doc_count = sqlite3_column_int64(stmt, 1);
         sqlite3_finalize(stmt);
 
+        if (term_id != 0)
+            term_dictionary.insert(term, hash, term_id);
         return term_id;
     }
 
@@ -215,152 +388,435 @@ namespace indexer {
 
         return doc_id;
     }
-    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ insert TDFM in db ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
-    auto Indexer::insert_term_document_matrix(long long term_id, long long doc_id, long long freq) -> void {
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ look up a document id without inserting, 0 if unknown ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::find_document(const std::string& document) -> long long {
         sqlite3_stmt* stmt;
+        long long doc_id = 0;
+        sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, "SELECT document_id FROM documents WHERE document_name = ?;", -1, &stmt, nullptr);
+        sqlite3_bind_text(stmt, 1, document.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            doc_id = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+        return doc_id;
+    }
 
-        // Insert the term into the term-document matrix
-        sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, 
-            "INSERT OR IGNORE INTO term_document_matrix (term_id, document_id, frequency, tf_idf) "
-            "VALUES (?, ?, ?, ?);", 
-            -1, &stmt, nullptr);
-        sqlite3_bind_int64(stmt, 1, term_id);
-        sqlite3_bind_int64(stmt, 2, doc_id);
-        sqlite3_bind_int64(stmt, 3, freq);  // Store the frequency
-        sqlite3_bind_double(stmt, 4, 0.0);  // Store temp tf-idf
-        sqlite3_step(stmt);
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ load stored fingerprints into the banded lookup table ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::load_fingerprints() -> void {
+        fingerprints.clear();
+        if (index_stream::Config::get().dedup == "off")
+            return;
+
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, "SELECT document_id, simhash FROM documents WHERE simhash != 0;", -1, &stmt, nullptr) != SQLITE_OK) {
+            std::cerr << "Failed to load fingerprints: " << sqlite3_errmsg(safe_check_cpy() ? temp_db_ : db_) << std::endl;
+            return;
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+            fingerprints.insert(static_cast<uint64_t>(sqlite3_column_int64(stmt, 1)), sqlite3_column_int64(stmt, 0));
         sqlite3_finalize(stmt);
     }
 
-    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ update tf-idf for all terms ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-    auto Indexer::update_idf() -> void {
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ take a document's stored fingerprint out of the lookup table ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // Reads documents.simhash, so call it before the row is rewritten or deleted
+    auto Indexer::forget_fingerprint(long long doc_id) -> void {
+        if (index_stream::Config::get().dedup == "off")
+            return;
+
         sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, "SELECT simhash FROM documents WHERE document_id = ?;", -1, &stmt, nullptr);
+        sqlite3_bind_int64(stmt, 1, doc_id);
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int64(stmt, 0) != 0)
+            fingerprints.erase(static_cast<uint64_t>(sqlite3_column_int64(stmt, 0)), doc_id);
+        sqlite3_finalize(stmt);
+    }
 
-        // Get the total number of documents (for IDF calculation)
-        sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, "SELECT total_documents FROM stats;", -1, &stmt, nullptr);
-        if (sqlite3_step(stmt) != SQLITE_ROW) {
-            std::cerr << "Failed to get total_documents: " << sqlite3_errmsg(safe_check_cpy() ? temp_db_ : db_) << std::endl;
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ drop every posting of one document ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // The document's forward list names the terms it is in; their lists lose it, and their
+    // document counts drop, on the next flush
+    auto Indexer::remove_postings(long long doc_id) -> void {
+        postings.remove(safe_check_cpy() ? temp_db_ : db_, doc_id);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ load deleted-but-not-compacted documents into the bitmap ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::load_tombstones() -> void {
+        sqlite3_stmt* stmt;
+        tombstones.clear();
+        if (sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, "SELECT document_id FROM tombstones;", -1, &stmt, nullptr) != SQLITE_OK) {
+            std::cerr << "Failed to load tombstones: " << sqlite3_errmsg(safe_check_cpy() ? temp_db_ : db_) << std::endl;
+            return;
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+            tombstones.set(sqlite3_column_int64(stmt, 0));
+        sqlite3_finalize(stmt);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ delete a document: tombstone now, reclaim postings on compaction ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::delete_document(const std::string& url) -> bool {
+        std::lock_guard<std::mutex> lock(ingest_mutex);
+        sqlite3* db = safe_check_cpy() ? temp_db_ : db_;
+        sqlite3_stmt* stmt;
+
+        // A collapsed duplicate only lives in the alias table
+        sqlite3_prepare_v2(db, "DELETE FROM document_aliases WHERE alias = ?;", -1, &stmt, nullptr);
+        sqlite3_bind_text(stmt, 1, url.c_str(), -1, SQLITE_STATIC);
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        bool removed_alias = sqlite3_changes(db) > 0;
+
+        long long doc_id = find_document(url);
+        if (doc_id == 0)
+            return removed_alias;
+
+        sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO tombstones (document_id) VALUES (?);", -1, &stmt, nullptr);
+        sqlite3_bind_int64(stmt, 1, doc_id);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            std::cerr << "Failed to tombstone document: " << sqlite3_errmsg(db) << std::endl;
             sqlite3_finalize(stmt);
+            return false;
+        }
+        sqlite3_finalize(stmt);
+
+        tombstones.set(doc_id);
+        std::cout << "Tombstoned document " << doc_id << ": " << url << std::endl;
+        return true;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ reclaim postings of tombstoned documents, merge posting generations ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::compact() -> void {
+        index_stream::TraceSpan trace("compact");
+        sqlite3* db = safe_check_cpy() ? temp_db_ : db_;
+        sqlite3_stmt* stmt;
+        std::vector<long long> dead;
+
+        sqlite3_prepare_v2(db, "SELECT document_id FROM tombstones;", -1, &stmt, nullptr);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+            dead.push_back(sqlite3_column_int64(stmt, 0));
+        sqlite3_finalize(stmt);
+
+        sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+        if (!dead.empty())
+            std::cout << "Compacting " << dead.size() << " deleted documents...\n";
+        for (long long doc_id : dead) {
+            remove_postings(doc_id);
+            // Once its tombstone bit is cleared a stale fingerprint would reject pages like it
+            forget_fingerprint(doc_id);
+            for (const char* query : {"DELETE FROM document_aliases WHERE document_id = ?;",
+                                      "DELETE FROM doc_locations WHERE document_id = ?;",
+                                      "DELETE FROM document_links WHERE document_id = ?;",
+                                      "DELETE FROM documents WHERE document_id = ?;",
+                                      "DELETE FROM tombstones WHERE document_id = ?;"}) {
+                sqlite3_prepare_v2(db, query, -1, &stmt, nullptr);
+                sqlite3_bind_int64(stmt, 1, doc_id);
+                sqlite3_step(stmt);
+                sqlite3_finalize(stmt);
+            }
+        }
+        if (!dead.empty()) {
+            // Blocks no document points at anymore, from deletes and from re-indexed pages
+            sqlite3_exec(db, "DELETE FROM doc_blocks WHERE block_id NOT IN (SELECT block_id FROM doc_locations);", nullptr, nullptr, nullptr);
+            postings.flush(db);
+        }
+        // Lists that stacked up too many generations, by deletes here or by earlier batches
+        postings.merge(db);
+        sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+        if (dead.empty())
             return;
+        refresh_total_documents();
+
+        // Searches still read the old store until it is swapped, so the bits stay set until then
+        if (safe_check_cpy())
+            reclaimed_documents.insert(reclaimed_documents.end(), dead.begin(), dead.end());
+        else
+            for (long long doc_id : dead)
+                tombstones.reset(doc_id);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ read corpus size from the stats table ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::total_documents() -> long long {
+        sqlite3_stmt* stmt;
+        long long total = 0;
+        sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, "SELECT total_documents FROM stats;", -1, &stmt, nullptr);
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            total = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+        return total;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ PageRank over the stored link graph -> documents.static_rank ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // Ranks are stored scaled by the page count, so an average page has rank 1 whatever the
+    // corpus size. The live store's ranks are published to searches right away; the write
+    // buffer's are published when it is swapped in.
+    auto Indexer::update_static_rank() -> void {
+        const auto& config = index_stream::Config::get();
+        sqlite3* db = safe_check_cpy() ? temp_db_ : db_;
+        auto started = std::chrono::steady_clock::now();
+
+        index_stream::TraceSpan trace("static_rank", "rank");
+        LinkGraph graph;
+        {
+            index_stream::TraceSpan load_trace("load_link_graph", "rank");
+            graph = LinkGraph::load(db);
+            load_trace.set_count(static_cast<int64_t>(graph.edges()));
+        }
+        PageRankResult pagerank;
+        {
+            index_stream::TraceSpan pagerank_trace("pagerank", "rank");
+            pagerank = compute_pagerank(graph, rank_pool, config.pagerank_iterations,
+                                        config.pagerank_tolerance, config.pagerank_damping);
+            pagerank_trace.set_count(pagerank.iterations);
+        }
+        for (double& rank : pagerank.ranks)
+            rank *= static_cast<double>(graph.nodes());
+
+        index_stream::TraceSpan store_trace("store_ranks", "rank");
+        sqlite3_stmt* stmt;
+        sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+        sqlite3_prepare_v2(db, "UPDATE documents SET static_rank = ? WHERE document_id = ?;", -1, &stmt, nullptr);
+        for (size_t node = 0; node < graph.nodes(); node++) {
+            sqlite3_bind_double(stmt, 1, pagerank.ranks[node]);
+            sqlite3_bind_int64(stmt, 2, graph.doc_ids[node]);
+            if (sqlite3_step(stmt) != SQLITE_DONE)
+                std::cerr << "Failed to store static rank: " << sqlite3_errmsg(db) << std::endl;
+            sqlite3_reset(stmt);
         }
-        long long total_documents = sqlite3_column_int64(stmt, 0);
-        std::cout << "Total Documents : " << total_documents << std::endl;
         sqlite3_finalize(stmt);
+        sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
 
-        // Fetch term-document matrix data
-        const char* select_query = R"(
-            SELECT term_id, document_id, frequency
-            FROM term_document_matrix;
-        )";
-        if (sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, select_query, -1, &stmt, nullptr) != SQLITE_OK) {
-            std::cerr << "Failed to prepare select_query: " << sqlite3_errmsg(safe_check_cpy() ? temp_db_ : db_) << std::endl;
+        links_changed = false;
+        ranked_at = std::chrono::steady_clock::now();
+        if (db == db_)
+            publish_static_ranks(graph.doc_ids, pagerank.ranks);
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(ranked_at - started).count();
+        std::cout << "Static rank: " << graph.nodes() << " pages, " << graph.edges() << " links, "
+                  << pagerank.iterations << " iterations (delta " << pagerank.delta << ") in " << elapsed << " ms" << std::endl;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ read the live store's static ranks into the search-side table ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::load_static_ranks() -> void {
+        std::vector<long long> doc_ids;
+        std::vector<double> ranks;
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db_, "SELECT document_id, static_rank FROM documents ORDER BY document_id;", -1, &stmt, nullptr) != SQLITE_OK) {
+            std::cerr << "Failed to load static ranks: " << sqlite3_errmsg(db_) << std::endl;
             return;
         }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            doc_ids.push_back(sqlite3_column_int64(stmt, 0));
+            ranks.push_back(sqlite3_column_double(stmt, 1));
+        }
+        sqlite3_finalize(stmt);
+        publish_static_ranks(doc_ids, ranks);
+    }
 
-        std::unordered_map<long long, long long> document_term_counts;
-        std::unordered_map<long long, double> term_idfs;
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ precompute each document's score factor and swap the table in ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::publish_static_ranks(const std::vector<long long>& doc_ids, const std::vector<double>& ranks) -> void {
+        const auto& config = index_stream::Config::get();
+        std::shared_ptr<const std::vector<float>> published;
+        if (config.static_rank && config.static_rank_weight > 0.0 && !doc_ids.empty()) {
+            auto boosts = std::make_shared<std::vector<float>>(static_cast<size_t>(doc_ids.back()) + 1, 1.0f);
+            for (size_t i = 0; i < doc_ids.size(); i++)
+                (*boosts)[doc_ids[i]] = static_cast<float>(1.0 + config.static_rank_weight * std::log1p(std::max(0.0, ranks[i])));
+            published = std::move(boosts);
+        }
+        std::lock_guard<std::mutex> lock(rank_mutex);
+        rank_boosts = std::move(published);
+    }
+
+    auto Indexer::static_rank_boosts() -> std::shared_ptr<const std::vector<float>> {
+        std::lock_guard<std::mutex> lock(rank_mutex);
+        return rank_boosts;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ renumber the write buffer's documents in static-rank order ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // Document 1 becomes the highest-ranked page, so posting lists, doc-id range shards and the
+    // deadline's partial results all reach the important pages first. Every table keyed by
+    // document id is remapped in two passes through negative ids, so no primary key collides
+    // midway, and every posting list is re-encoded in the new order as a single generation.
+    auto Indexer::renumber_documents() -> void {
+        index_stream::TraceSpan trace("renumber", "rank");
+        sqlite3* db = safe_check_cpy() ? temp_db_ : db_;
+        sqlite3_stmt* stmt;
+        std::cout << "Renumbering documents in static-rank order...\n";
 
-        // Iterate through the term-document matrix
+        sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+        execute_sql("CREATE TEMP TABLE doc_order (old_id INTEGER PRIMARY KEY, new_id INTEGER);");
+        execute_sql(R"(
+            INSERT INTO doc_order (old_id, new_id)
+            SELECT document_id, ROW_NUMBER() OVER (ORDER BY static_rank DESC, document_id) FROM documents;
+        )");
+
+        std::vector<long long> new_ids;
+        sqlite3_prepare_v2(db, "SELECT old_id, new_id FROM doc_order;", -1, &stmt, nullptr);
         while (sqlite3_step(stmt) == SQLITE_ROW) {
-            long long term_id = sqlite3_column_int64(stmt, 0);
-            long long doc_id = sqlite3_column_int64(stmt, 1);
-            long long frequency = sqlite3_column_int64(stmt, 2);
-
-            // Fetch total terms for the document
-            sqlite3_stmt* doc_stmt;
-            sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, "SELECT total_terms FROM documents WHERE document_id = ?;", -1, &doc_stmt, nullptr);
-            sqlite3_bind_int64(doc_stmt, 1, doc_id);
-            if (sqlite3_step(doc_stmt) == SQLITE_ROW) {
-                long long total_terms = sqlite3_column_int64(doc_stmt, 0);
-                double tf = static_cast<double>(frequency) / total_terms;
-                if (term_idfs.find(term_id) == term_idfs.end()) {
-                    // Calculate IDF
-                    sqlite3_stmt* term_stmt;
-                    sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, "SELECT document_count FROM terms WHERE term_id = ?;", -1, &term_stmt, nullptr);
-                    sqlite3_bind_int64(term_stmt, 1, term_id);
-                    if (sqlite3_step(term_stmt) == SQLITE_ROW) {
-                        long long document_count = sqlite3_column_int64(term_stmt, 0);
-                        double idf = log(static_cast<double>(total_documents) / (document_count + 1)); // Add 1 to avoid division by zero
-                        term_idfs[term_id] = idf;
-                    }
-                    sqlite3_finalize(term_stmt);
-                }
+            long long old_id = sqlite3_column_int64(stmt, 0);
+            if (static_cast<size_t>(old_id) >= new_ids.size())
+                new_ids.resize(static_cast<size_t>(old_id) + 1, 0);
+            new_ids[old_id] = sqlite3_column_int64(stmt, 1);
+        }
+        sqlite3_finalize(stmt);
 
-                // Calculate TF-IDF
-                double tf_idf = tf * term_idfs[term_id];
-
-                // Update TF-IDF in the database
-                sqlite3_stmt* update_stmt;
-                sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, "UPDATE term_document_matrix SET tf_idf = ? WHERE term_id = ? AND document_id = ?;", -1, &update_stmt, nullptr);
-                sqlite3_bind_double(update_stmt, 1, tf_idf);
-                sqlite3_bind_int64(update_stmt, 2, term_id);
-                sqlite3_bind_int64(update_stmt, 3, doc_id);
-                if (sqlite3_step(update_stmt) != SQLITE_DONE) {
-                    std::cerr << "Failed to update TF-IDF: " << sqlite3_errmsg(safe_check_cpy() ? temp_db_ : db_) << std::endl;
-                }
-                sqlite3_finalize(update_stmt);
-            }
-            sqlite3_finalize(doc_stmt);
+        for (const char* table : {"documents", "document_terms", "doc_locations", "document_links", "tombstones", "document_aliases"}) {
+            std::string name(table);
+            execute_sql(("DELETE FROM " + name + " WHERE document_id NOT IN (SELECT old_id FROM doc_order);").c_str());
+            execute_sql(("UPDATE " + name + " SET document_id = -(SELECT new_id FROM doc_order WHERE old_id = " + name + ".document_id);").c_str());
+            execute_sql(("UPDATE " + name + " SET document_id = -document_id;").c_str());
         }
+
+        std::vector<long long> term_ids;
+        sqlite3_prepare_v2(db, "SELECT DISTINCT term_id FROM posting_segments;", -1, &stmt, nullptr);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+            term_ids.push_back(sqlite3_column_int64(stmt, 0));
         sqlite3_finalize(stmt);
-    }
 
-    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ insert in memory term document matrix to persistant store ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
-    auto Indexer::transform_to_persist() -> void {
-        sqlite3_exec(safe_check_cpy() ? temp_db_ : db_, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
-        for (const auto& [term, doc_queue] : term_document_matrix) {
-            long long term_id = get_or_insert_term(term);
-            auto term_docs = doc_queue;
-            while (!term_docs.empty()) {
-                const auto [url, count] = term_docs.front();
-                term_docs.pop();
-                long long doc_id = get_or_insert_document(url);
-                insert_term_document_matrix(term_id, doc_id, count);
+        std::vector<Posting> list;
+        Posting posting;
+        for (long long term_id : term_ids) {
+            list.clear();
+            {
+                PostingCursor cursor;
+                if (!cursor.open(db, term_id))
+                    continue;
+                while (cursor.next(posting))
+                    list.push_back(posting);
             }
+            std::erase_if(list, [&new_ids](Posting& posting) {
+                posting.doc_id = static_cast<size_t>(posting.doc_id) < new_ids.size() ? new_ids[posting.doc_id] : 0;
+                return posting.doc_id == 0;
+            });
+            std::sort(list.begin(), list.end(), [](const Posting& a, const Posting& b) { return a.doc_id < b.doc_id; });
+            PostingStore::write_list(db, term_id, list);
         }
-        sqlite3_exec(db_, "COMMIT;", nullptr, nullptr, nullptr);
+
+        execute_sql("DROP TABLE doc_order;");
+        sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+        renumbered = true;
+        std::cout << "Renumbered " << (new_ids.empty() ? 0 : std::count_if(new_ids.begin(), new_ids.end(), [](long long id) { return id != 0; }))
+                  << " documents" << std::endl;
     }
 
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ create TDFM ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
-    auto Indexer::index_updater(std::string& document, std::string& url) -> void {
-        if (document.empty()) return;
+    auto Indexer::index_updater(std::string& document, std::string& url) -> bool {
+        if (document.empty()) return false;
 
-        std::istringstream stream(document);
-        std::string word;
-        std::unordered_map<std::string, long long> wordCount;
-        std::transform(document.begin(), document.end(), document.begin(), ::tolower);
+        // Terms are views into the normalized document, which outlives the counting below; the
+        // table and the hash buffer keep their capacity from one document to the next
+        word_counts.clear();
+        surface_forms.clear();
+        const auto& analyzer = Analyzer::get_instance();
 
         long long total_terms = 0;  // Track total number of terms
         long long unique_terms = 0;  // Track unique terms
 
+        // Normalization rewrites the buffer, the forward store keeps the text as parsed
+        const bool keep_text = index_stream::Config::get().snippets;
+        std::string text = keep_text ? document : std::string{};
+        token_positions.clear();
+
         // Count word frequencies and total terms
-        while (stream >> word) {
-            word.erase(std::remove_if(word.begin(), word.end(), ::ispunct), word.end());
-            if (!word.empty()) {
-                if (wordCount[word] == 0) {
-                    unique_terms++;  // Increment unique term count
+        index_stream::TraceSpan tokenize_trace("tokenize");
+        for_each_token(document.data(), document.size(), [&](std::string_view token) {
+            ingest_stats.tokens++;
+            surface_forms.push_back(hash_term(token));
+
+            // The analyzer rewrites the token in place, inside the document buffer
+            size_t offset = static_cast<size_t>(token.data() - document.data());
+            std::string_view word = analyzer.apply(document.data() + offset, token.size());
+            if (word.empty()) {
+                ingest_stats.stopwords++;
+                return;
+            }
+            uint64_t hash = hash_term(word);
+            if (keep_text)
+                token_positions.push_back({static_cast<uint32_t>(hash), static_cast<uint32_t>(offset),
+                                           static_cast<uint16_t>(std::min<size_t>(token.size(), UINT16_MAX))});
+
+            bool inserted;
+            word_counts.value(word, hash, inserted)++;
+            if (inserted) {
+                unique_terms++;  // Increment unique term count
+            }
+            total_terms++;  // Increment total terms count
+        });
+        tokenize_trace.set_count(total_terms);
+
+        // Drop (or collapse) documents whose fingerprint is within dedup_distance of one already
+        // indexed under a different URL, before any of their postings are written
+        index_stream::TraceSpan dedup_trace("dedup");
+        const auto& config = index_stream::Config::get();
+        long long existing_id = find_document(url);
+        uint64_t fingerprint = 0;
+        if (config.dedup != "off" && !word_counts.empty()) {
+            fingerprint = simhash(word_counts.entries());
+            long long original = fingerprints.find(fingerprint);
+            if (original != 0 && original != existing_id && !tombstones.test(original)) {
+                ingest_stats.duplicates++;
+                std::cout << "Near-duplicate of document " << original << ", skipping: " << url << std::endl;
+
+                if (config.dedup == "collapse") {
+                    sqlite3_stmt* alias_stmt;
+                    sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, "INSERT OR REPLACE INTO document_aliases (alias, document_id) VALUES (?, ?);", -1, &alias_stmt, nullptr);
+                    sqlite3_bind_text(alias_stmt, 1, url.c_str(), -1, SQLITE_STATIC);
+                    sqlite3_bind_int64(alias_stmt, 2, original);
+                    sqlite3_step(alias_stmt);
+                    sqlite3_finalize(alias_stmt);
                 }
-                wordCount[word]++;
-                total_terms++;  // Increment total terms count
+                return false;
             }
         }
 
-        long long doc_id = get_or_insert_document(url);
+        std::sort(surface_forms.begin(), surface_forms.end());
+        ingest_stats.raw_postings += static_cast<long long>(std::unique(surface_forms.begin(), surface_forms.end()) - surface_forms.begin());
+        ingest_stats.postings += unique_terms;
+
+        // A recrawled URL replaces its old postings: each list it was in gets a removal marker (or
+        // the new posting) in the batch's generation, and the old posting is dropped when that
+        // list's generations are next merged
+        if (existing_id != 0) {
+            remove_postings(existing_id);
+            if (tombstones.test(existing_id)) {
+                sqlite3_stmt* revive_stmt;
+                sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, "DELETE FROM tombstones WHERE document_id = ?;", -1, &revive_stmt, nullptr);
+                sqlite3_bind_int64(revive_stmt, 1, existing_id);
+                sqlite3_step(revive_stmt);
+                sqlite3_finalize(revive_stmt);
+                tombstones.reset(existing_id);
+            }
+        }
 
-        // Update the term_count and total_terms in the documents table
+        index_stream::TraceSpan persist_trace("persist");
+        long long doc_id = existing_id != 0 ? existing_id : get_or_insert_document(url);
+        // A recrawled page no longer has its old content, so other URLs carrying it are not duplicates
+        if (existing_id != 0)
+            forget_fingerprint(existing_id);
+        if (fingerprint != 0)
+            fingerprints.insert(fingerprint, doc_id);
+
+        // Update the term_count, total_terms and fingerprint in the documents table
         sqlite3_stmt* stmt;
-        sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, "UPDATE documents SET term_count = ?, total_terms = ? WHERE document_id = ?;", -1, &stmt, nullptr);
+        sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, "UPDATE documents SET term_count = ?, total_terms = ?, simhash = ? WHERE document_id = ?;", -1, &stmt, nullptr);
         sqlite3_bind_int64(stmt, 1, unique_terms);
         sqlite3_bind_int64(stmt, 2, total_terms);
-        sqlite3_bind_int64(stmt, 3, doc_id);
+        sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(fingerprint));
+        sqlite3_bind_int64(stmt, 4, doc_id);
         sqlite3_step(stmt);
         sqlite3_finalize(stmt);
 
-        // Insert the term frequencies into the term-document matrix
-        for (const auto& [term, count] : wordCount) {
-            long long term_id = get_or_insert_term(term);
-            insert_term_document_matrix(term_id, doc_id, count);
+        // Buffer the postings; their lists and document counts are rewritten once per batch
+        std::vector<std::pair<long long, uint32_t>> term_frequencies;
+        term_frequencies.reserve(word_counts.size());
+        const auto& entries = word_counts.entries();
+        for (size_t i = 0; i < entries.size(); i++)
+            term_frequencies.emplace_back(get_or_insert_term(entries[i].first, word_counts.hash(i)), static_cast<uint32_t>(entries[i].second));
+        postings.add(safe_check_cpy() ? temp_db_ : db_, doc_id, static_cast<uint32_t>(total_terms), term_frequencies);
+
+        if (keep_text)
+            doc_store.add(safe_check_cpy() ? temp_db_ : db_, doc_id, text, token_positions);
+        if (config.static_rank) {
+            write_links(safe_check_cpy() ? temp_db_ : db_, doc_id, outlinks);
+            links_changed = true;
         }
+        return true;
     }
 
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ parse document ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
@@ -368,56 +824,214 @@ namespace indexer {
         if (f_name.find(".gitkeep") != std::string::npos)
             return;
 
-        std::string document{};
+        // Segments still being appended to by the crawler
+        if (f_name.size() > 4 && f_name.compare(f_name.size() - 4, 4, ".tmp") == 0)
+            return;
+
         if (this->indexed_documents.find(f_name) == this->indexed_documents.end()) {
             this->indexed_documents.insert(f_name);
 
-            std::string url = url_extractor(f_name);
-            document_parser(f_name, document);
-            index_updater(document, url);  // Update index, including frequencies
-            transform_to_persist();  // Move memory matrix to persistent storage
+            if (is_segment_file(f_name)) {
+                process_segment(f_name);
+                return;
+            }
+
+            // One read per dump file: the URL header and the page come out of the same buffer
+            std::string content;
+            {
+                index_stream::TraceSpan trace("read");
+                std::ifstream file(f_name, std::ios::binary);
+                if (!file.is_open()) {
+                    std::cerr << "Failed to open file: " << f_name << std::endl;
+                    return;
+                }
+                content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                trace.set_count(static_cast<int64_t>(content.size()));
+            }
+
+            const std::string delimiter = "\n---URL---\n";
+            size_t pos = content.find(delimiter);
+            if (pos != std::string::npos) {
+                std::string url = content.substr(0, pos);
+                url.erase(std::remove(url.begin(), url.end(), '\n'), url.end());
+                index_document(url, content);
+            }
 
-            term_document_matrix.clear();
             delete_file(f_name);
 
             // Update total_documents in stats table
-            std::cout << "Updating total_documents" << std::endl;
-            sqlite3_stmt* stmt;
-            size_t document_count {};
-            const char* count_query = "SELECT COUNT(*) FROM documents;";
-
-            if (sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, count_query, -1, &stmt, nullptr) == SQLITE_OK) {
-                if (sqlite3_step(stmt) == SQLITE_ROW) {
-                    document_count = sqlite3_column_int(stmt, 0);
-                } else {
-                    std::cerr << "Failed to count documents: " << sqlite3_errmsg(db_) << std::endl;
-                }
+            refresh_total_documents();
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ index every record of a packed dump segment ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::process_segment(const std::string& f_name) -> void {
+        index_stream::TraceSpan trace("segment");
+        SegmentReader reader;
+        if (!reader.open(f_name)) {
+            this->indexed_documents.erase(f_name);
+            return;
+        }
+
+        std::string url, html;
+        size_t records = 0;
+        while (reader.next(url, html)) {
+            index_document(url, html);
+            records++;
+        }
+
+        std::cout << "Segment '" << f_name << "': " << records << " records";
+        if (reader.corrupt() > 0)
+            std::cout << ", " << reader.corrupt() << " corrupt records skipped";
+        std::cout << std::endl;
+
+        delete_file(f_name);
+        refresh_total_documents();
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ parse and index one page ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::index_document(std::string& url, const std::string& html) -> void {
+        index_stream::TraceSpan trace("index_document");
+        std::string document{};
+        outlinks.clear();
+        if (index_stream::Config::get().static_rank) {
+            index_stream::TraceSpan links_trace("extract_links");
+            outlinks = extract_links(html, url);
+        }
+        {
+            index_stream::TraceSpan parse_trace("parse");
+            parse_html(html, document);
+        }
+        index_updater(document, url);  // Update index, including frequencies
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ recount documents into the stats table ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::refresh_total_documents() -> void {
+        index_stream::TraceSpan trace("count_documents");
+        std::cout << "Updating total_documents" << std::endl;
+        sqlite3_stmt* stmt;
+        size_t document_count {};
+        const char* count_query = "SELECT COUNT(*) FROM documents;";
+
+        if (sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, count_query, -1, &stmt, nullptr) == SQLITE_OK) {
+            if (sqlite3_step(stmt) == SQLITE_ROW) {
+                document_count = sqlite3_column_int(stmt, 0);
             } else {
-                std::cerr << "Failed to prepare count query: " << sqlite3_errmsg(db_) << std::endl;
+                std::cerr << "Failed to count documents: " << sqlite3_errmsg(db_) << std::endl;
             }
-            sqlite3_finalize(stmt);
+        } else {
+            std::cerr << "Failed to prepare count query: " << sqlite3_errmsg(db_) << std::endl;
+        }
+        sqlite3_finalize(stmt);
 
-            const char* update_query = "UPDATE stats SET total_documents = ?;";
-            if (sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, update_query, -1, &stmt, nullptr) == SQLITE_OK) {
-                sqlite3_bind_int(stmt, 1, document_count);
-                if (sqlite3_step(stmt) != SQLITE_DONE) {
-                    std::cerr << "Failed to update total_documents: " << sqlite3_errmsg(db_) << std::endl;
-                }
-            } else {
-                std::cerr << "Failed to prepare update query: " << sqlite3_errmsg(db_) << std::endl;
+        const char* update_query = "UPDATE stats SET total_documents = ?;";
+        if (sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, update_query, -1, &stmt, nullptr) == SQLITE_OK) {
+            sqlite3_bind_int(stmt, 1, document_count);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                std::cerr << "Failed to update total_documents: " << sqlite3_errmsg(db_) << std::endl;
             }
-            sqlite3_finalize(stmt);
+        } else {
+            std::cerr << "Failed to prepare update query: " << sqlite3_errmsg(db_) << std::endl;
         }
+        sqlite3_finalize(stmt);
     }
 
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ crawl documents in dump directory ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
     auto Indexer::directory_spider() -> void {
+        index_stream::TraceSpan trace("directory_spider");
+        ingest_stats = {};
+        load_fingerprints();
+        sqlite3_exec(safe_check_cpy() ? temp_db_ : db_, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
         for (const auto& dir_entry : std::filesystem::directory_iterator(this->dump_dir)) {
             std::string f_name = dir_entry.path().string();
             std::cout << f_name << std::endl;
             process_file(f_name);
         }
-        update_idf();
+        flush_batch(safe_check_cpy() ? temp_db_ : db_);
+        report_ingest_stats();
+
+        // A full rebuild always re-ranks; the swap publishes the new order
+        const auto& config = index_stream::Config::get();
+        if (config.static_rank) {
+            update_static_rank();
+            if (config.static_rank_renumber)
+                renumber_documents();
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ write out the batch's postings and text, then commit it ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::flush_batch(sqlite3* db) -> void {
+        {
+            index_stream::TraceSpan trace("merge_postings");
+            postings.flush(db);
+        }
+        {
+            index_stream::TraceSpan trace("flush_doc_store");
+            doc_store.flush(db);
+        }
+        index_stream::TraceSpan trace("commit");
+        sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ index one micro-batch straight into the live store ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    template<typename F>
+    auto Indexer::run_batch(F&& body) -> void {
+        std::lock_guard<std::mutex> lock(ingest_mutex);
+        index_stream::TraceSpan trace("batch");
+        if (fingerprints.size() == 0)
+            load_fingerprints();
+
+        ingest_stats = {};
+        compact();
+
+        // The whole batch becomes visible to searches at COMMIT
+        sqlite3_exec(db_, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+        body();
+        flush_batch(db_);
+        report_ingest_stats();
+
+        // PageRank is global, so it is rerun at most every static_rank_interval_s while pages stream in
+        const auto& config = index_stream::Config::get();
+        if (config.static_rank && links_changed &&
+            std::chrono::steady_clock::now() - ranked_at >= std::chrono::seconds(config.static_rank_interval_s))
+            update_static_rank();
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ index a batch of dump files ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::index_batch(const std::vector<std::string>& files) -> void {
+        run_batch([&] {
+            for (const auto& f_name : files)
+                process_file(f_name);
+        });
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ index a batch of pages streamed in over /ingest ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::index_records(std::vector<IngestRecord>& records) -> void {
+        run_batch([&] {
+            for (auto& record : records)
+                index_document(record.url, record.html);
+            refresh_total_documents();
+        });
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ report how much analysis and deduplication shrank the index ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::report_ingest_stats() const -> void {
+        const auto& stats = ingest_stats;
+        if (stats.tokens == 0)
+            return;
+
+        auto percent = [](long long part, long long whole) {
+            return whole == 0 ? 0.0 : 100.0 * static_cast<double>(part) / static_cast<double>(whole);
+        };
+
+        std::cout << "=== Ingest ===" << std::endl;
+        std::cout << "Tokens: " << stats.tokens << " | Stopwords dropped: " << stats.stopwords
+                  << " (" << std::fixed << std::setprecision(1) << percent(stats.stopwords, stats.tokens) << "%)" << std::endl;
+        std::cout << "Postings: " << stats.raw_postings << " -> " << stats.postings
+                  << " (" << percent(stats.raw_postings - stats.postings, stats.raw_postings) << "% smaller)" << std::endl;
+        if (index_stream::Config::get().dedup != "off")
+            std::cout << "Near-duplicates dropped: " << stats.duplicates << std::endl;
+        std::cout << std::defaultfloat;
     }
 
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ helper to safely set cpy ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
@@ -433,11 +1047,19 @@ namespace indexer {
     }
 
     auto Indexer::merge_db() -> void {
-        std::string src = "../db/document_store.db";
-        std::string dest = "../db/temp_document_store.db";
+        const std::string& src = db_path;
+        const std::string& dest = temp_db_path;
         
         std::cout << "Init DB Merge...\n";
+        index_stream::TraceSpan trace("swap");
 
+        // Both handles point at files that are about to be replaced
+        sqlite3_close(temp_db_);
+        temp_db_ = nullptr;
+        sqlite3_close(db_);
+
+        std::remove((src + "-wal").c_str());
+        std::remove((src + "-shm").c_str());
         if (std::remove(src.c_str()) == 0) {
             std::cout << "Original db removed" << std::endl;
             if (std::rename(dest.c_str(), src.c_str()) == 0) {
@@ -447,93 +1069,460 @@ namespace indexer {
             }
         }
 
+        if (sqlite3_open(src.c_str(), &db_) != SQLITE_OK) {
+            std::cerr << "Cannot open database: " << sqlite3_errmsg(db_) << std::endl;
+            exit(1);
+        }
+        configure_connection(db_);
+
+        // Workers reopen their read connections on their next query
+        db_generation.fetch_add(1, std::memory_order_release);
+
+        // The swapped-in store no longer holds the compacted documents
+        for (long long doc_id : reclaimed_documents)
+            tombstones.reset(doc_id);
+        reclaimed_documents.clear();
+
+        // Renumbered ids invalidate everything keyed by the old ones
+        if (renumbered) {
+            load_tombstones();
+            fingerprints.clear();
+            renumbered = false;
+        }
+        load_static_ranks();
+
         std::cout << "DB updated sucessfully!\n";
     }
 
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ insert create new write buffer db ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
     auto Indexer::update_db() -> void {
-        std::string src = "../db/document_store.db";
-        std::string dest = "../db/temp_document_store.db";
+        std::lock_guard<std::mutex> lock(ingest_mutex);
+        index_stream::TraceSpan trace("update_db");
+        const std::string& dest = temp_db_path;
 
         std::cout << "Initializing write buffer db....\n";
-        std::ifstream read_db(src, std::ios::binary);
-        std::ofstream write_db(dest, std::ios::binary);
-
-
-        if (!read_db || !write_db)
-            std::cerr << "Error accessing file" << std::endl;
-
-        write_db << read_db.rdbuf();
-        read_db.close();
-        write_db.close();
-
+        std::remove(dest.c_str());
         if (sqlite3_open(dest.c_str(), &temp_db_) != SQLITE_OK) {
             std::cerr << "Cannot open database: " << sqlite3_errmsg(temp_db_) << std::endl;
             exit(1);
         }
+
+        // A plain file copy would miss whatever still sits in the WAL, the backup API copies
+        // a consistent snapshot of the store
+        {
+            index_stream::TraceSpan snapshot_trace("snapshot");
+            sqlite3_backup* backup = sqlite3_backup_init(temp_db_, "main", db_, "main");
+            if (!backup || sqlite3_backup_step(backup, -1) != SQLITE_DONE)
+                std::cerr << "Error copying database: " << sqlite3_errmsg(temp_db_) << std::endl;
+            sqlite3_backup_finish(backup);
+        }
+        configure_connection(temp_db_);
         std::cout << "Init document parsing...\n";
 
         set_safe_copy(true);
+        compact();
         directory_spider();
         set_safe_copy(false);
     }
 
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Helper function to tokenize query ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
-    auto Indexer::tokenize_query(const std::string& query) -> std::vector<std::string> {
-        std::vector<std::string> terms;
-        std::stringstream ss(query);
-        std::string term;
-        
-        while (ss >> term) 
-            terms.push_back(term);
+    // Normalizes and analyzes the query in place with the same chain the indexer uses, so query
+    // terms and indexed terms always agree. The views point into the query buffer.
+    auto Indexer::tokenize_query(std::pmr::string& query) -> std::pmr::vector<std::string_view> {
+        std::pmr::vector<std::string_view> terms(query.get_allocator());
+        const auto& analyzer = Analyzer::get_instance();
+        for_each_token(query.data(), query.size(), [&](std::string_view token) {
+            std::string_view term = analyzer.apply(query.data() + (token.data() - query.data()), token.size());
+            if (!term.empty())
+                terms.push_back(term);
+        });
 
         return terms;
     }
 
-    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Basic Search Function to test my stuff ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
-    auto Indexer::search(const std::string& query) -> std::vector<std::pair<std::string, double>> {
-        std::vector<std::pair<std::string, double>> final_results;
-        std::unordered_map<std::string, double> document_scores;
-        
-        std::vector<std::string> terms = tokenize_query(query);
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ query terms -> dictionary terms, expanding the ones not found ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // A term that is in the dictionary with at least one document is taken as is; any other term
+    // is replaced by its closest fuzzy expansions. A dictionary term reached twice is kept once,
+    // at its smallest distance.
+    auto Indexer::match_terms(ReadConnection& connection, const std::pmr::vector<std::string_view>& terms,
+                              std::pmr::memory_resource* mr) -> std::pmr::vector<TermMatch> {
+        static const char* const term_query = "SELECT term_id, document_count FROM terms WHERE term = ?";
+
+        std::pmr::vector<TermMatch> matches(mr);
+        auto keep = [&matches](TermMatch match) {
+            auto seen = std::find_if(matches.begin(), matches.end(), [&match](const TermMatch& m) { return m.term_id == match.term_id; });
+            if (seen == matches.end())
+                matches.push_back(std::move(match));
+            else if (match.distance < seen->distance)
+                *seen = std::move(match);
+        };
+
+        for (const auto& term : terms) {
+            sqlite3_stmt* stmt = connection.statement(term_query);
+            if (!stmt)
+                break;
+            if (sqlite3_bind_text(stmt, 1, term.data(), static_cast<int>(term.size()), SQLITE_STATIC) != SQLITE_OK) {
+                std::cerr << "Failed to bind query term: " << sqlite3_errmsg(connection.handle()) << std::endl;
+                continue;  // Skip this term and continue with the next one
+            }
+            bool found = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int64(stmt, 1) > 0;
+            if (found)
+                keep({std::pmr::string(term, mr), sqlite3_column_int64(stmt, 0), sqlite3_column_int64(stmt, 1), 0});
+            sqlite3_reset(stmt);
+            if (!found)
+                for (auto& expansion : fuzzy_expand(connection, term, mr))
+                    keep(std::move(expansion));
+        }
+        return matches;
+    }
 
-        const char* search_query = R"(
-            SELECT d.document_name, td.tf_idf
-            FROM term_document_matrix td
-            JOIN documents d ON td.document_id = d.document_id
-            WHERE td.term_id = (SELECT term_id FROM terms WHERE term = ?)
-        )";
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ page cache hits and misses of a connection so far ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // SQLite keeps them as wrapping 32-bit counters, so only differences are meaningful
+    static auto page_cache_counters(sqlite3* db) -> std::pair<uint32_t, uint32_t> {
+        int hits = 0, misses = 0, highwater = 0;
+        sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_HIT, &hits, &highwater, 0);
+        sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_MISS, &misses, &highwater, 0);
+        return {static_cast<uint32_t>(hits), static_cast<uint32_t>(misses)};
+    }
 
-        for (const auto& query_term : terms) {
-            sqlite3_stmt* stmt;
+    static auto add_page_cache(SearchProfile& profile, sqlite3* db, std::pair<uint32_t, uint32_t> before) -> void {
+        auto after = page_cache_counters(db);
+        profile.cache_hits += static_cast<uint32_t>(after.first - before.first);
+        profile.cache_misses += static_cast<uint32_t>(after.second - before.second);
+    }
 
-            if (sqlite3_prepare_v2(safe_check_cpy() ? temp_db_ : db_, search_query, -1, &stmt, nullptr) != SQLITE_OK) {
-                std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(safe_check_cpy() ? temp_db_ : db_) << std::endl;
-                continue;  // Skip this term and continue with the next one
-            }
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ score one doc-id range and keep its top k ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // Each term's segments are opened as BLOBs and their skip tables take the cursor straight to
+    // the first block of this shard's range; decoding stops at the first document past it. A
+    // posting scores frequency / length * the term's weight (its IDF, local or global).
+    // The cursors of a shard read inside one read transaction, so they see one version of
+    // every list while compaction merges generations on the live store.
+    // Scores go to the query thread's dense ScoreAccumulator over the range: postings stored as
+    // impacts add their term's fixed-point table entry, so a block is a lookup and an add per
+    // posting. Draining it walks only the touched pages and keeps the top k in a bounded heap;
+    // tombstones are tested once per scored document instead of once per posting.
+    // The deadline is checked every DEADLINE_CHECK_ROWS postings; once it passes the shard stops
+    // and ranks what it has. Caller holds the tombstone read lock.
+    auto Indexer::search_shard(const std::pmr::vector<long long>& term_ids, const std::pmr::vector<double>& weights,
+                               long long first_doc, long long last_doc, size_t top_k, SearchDeadline* deadline,
+                               const std::vector<float>* boosts, SearchProfile* profile) -> std::vector<ScoredDocument> {
+        constexpr unsigned DEADLINE_CHECK_ROWS = 1024;
+
+        std::vector<ScoredDocument> results;
+        ReadConnection& connection = reader();
+
+        double max_weight = 0.0;
+        for (double weight : weights)
+            max_weight = std::max(max_weight, std::abs(weight));
+        thread_local ScoreAccumulator accumulator;
+        accumulator.begin(first_doc, last_doc, max_weight, term_ids.size());
+
+        std::pair<uint32_t, uint32_t> cache_before;
+        std::vector<size_t> postings_read;
+        if (profile) {
+            cache_before = page_cache_counters(connection.handle());
+            postings_read.resize(term_ids.size());
+        }
 
-            if (sqlite3_bind_text(stmt, 1, query_term.c_str(), -1, SQLITE_TRANSIENT) != SQLITE_OK) {
-                std::cerr << "Failed to bind query term: " << sqlite3_errmsg(safe_check_cpy() ? temp_db_ : db_) << std::endl;
-                sqlite3_finalize(stmt);
-                continue;  // Skip this term and continue with the next one
+        // One snapshot for all of the shard's cursors: a merge committed between listing a
+        // term's segments and opening them would otherwise delete them from under the cursor
+        const bool snapshot = sqlite3_get_autocommit(connection.handle())
+                              && sqlite3_exec(connection.handle(), "BEGIN;", nullptr, nullptr, nullptr) == SQLITE_OK;
+
+        std::array<Posting, POSTING_BLOCK_SIZE> block;
+        unsigned rows = 0;
+        bool stopped = deadline && deadline->passed();
+        for (size_t i = 0; i < term_ids.size() && !stopped; i++) {
+            PostingCursor cursor;
+            if (!cursor.open(connection.handle(), term_ids[i], 0, connection.statement(PostingCursor::SEGMENTS_QUERY)))
+                continue;
+            cursor.seek(first_doc);
+            const ScoreAccumulator::ImpactTable table = accumulator.impact_table(weights[i]);
+            size_t read = 0;
+            bool done = false;
+            while (!done) {
+                size_t count = cursor.read(block.data(), block.size());
+                if (count == 0)
+                    break;
+                // The block the seek landed in may start before the range; the list goes on past it
+                auto by_doc = [](const Posting& posting, long long doc_id) { return posting.doc_id < doc_id; };
+                auto begin = std::lower_bound(block.begin(), block.begin() + count, first_doc, by_doc);
+                auto end = block.begin() + count;
+                if (block[count - 1].doc_id > last_doc) {
+                    end = std::lower_bound(begin, end, last_doc + 1, by_doc);
+                    done = true;
+                }
+                if (begin != end)
+                    accumulator.add(block.data() + (begin - block.begin()), static_cast<size_t>(end - begin), table, weights[i]);
+                read += static_cast<size_t>(end - block.begin());
+                rows += static_cast<unsigned>(count);
+                if (deadline && rows >= DEADLINE_CHECK_ROWS) {
+                    rows = 0;
+                    if (deadline->passed()) {
+                        stopped = true;
+                        break;
+                    }
+                }
             }
+            if (profile)
+                postings_read[i] = read;
+        }
+        if (snapshot)
+            sqlite3_exec(connection.handle(), "COMMIT;", nullptr, nullptr, nullptr);
+
+        // Blend in the static rank; pages indexed since the last PageRank run keep their score
+        auto by_score = [](const ScoredDocument& a, const ScoredDocument& b) {
+            return a.score != b.score ? a.score > b.score : a.doc_id < b.doc_id;
+        };
+        size_t scored = 0;
+        results.reserve(top_k);
+        accumulator.drain([&](long long doc_id, double score) {
+            if (tombstones.test_unlocked(doc_id))
+                return;
+            scored++;
+            bool ranked = boosts && static_cast<size_t>(doc_id) < boosts->size();
+            ScoredDocument candidate {doc_id, ranked ? score * (*boosts)[doc_id] : score};
+            if (results.size() < top_k) {
+                results.push_back(candidate);
+                std::push_heap(results.begin(), results.end(), by_score);
+            } else if (top_k > 0 && by_score(candidate, results.front())) {
+                std::pop_heap(results.begin(), results.end(), by_score);
+                results.back() = candidate;
+                std::push_heap(results.begin(), results.end(), by_score);
+            }
+        });
+
+        if (profile) {
+            std::lock_guard<std::mutex> lock(profile->mutex);
+            for (size_t i = 0; i < postings_read.size() && i < profile->terms.size(); i++)
+                profile->terms[i].postings_read += postings_read[i];
+            profile->documents_scored += scored;
+            add_page_cache(*profile, connection.handle(), cache_before);
+        }
+        return results;
+    }
 
-            while (sqlite3_step(stmt) == SQLITE_ROW) {
-                std::string document_name(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
-                double tf_idf = sqlite3_column_double(stmt, 1);
-                document_scores[document_name] += tf_idf;
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ exact scores for the top k of a quantized search ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // The forward store keeps every indexed token's term hash, so a document's exact frequencies
+    // and length are recounted from its stored tokens. Documents without stored text keep their
+    // impact score.
+    auto Indexer::rescore_exact(ReadConnection& connection, const std::vector<uint32_t>& term_hashes, const std::pmr::vector<double>& weights,
+                                const std::vector<float>* boosts, std::vector<ScoredDocument>& results) -> void {
+        std::unordered_map<long long, std::string> block_cache;
+        std::vector<TokenPosition> tokens;
+        std::string_view text;
+        for (auto& result : results) {
+            if (!DocumentStore::load(connection, result.doc_id, block_cache, text, tokens) || tokens.empty())
+                continue;
+            double score = 0.0;
+            for (size_t i = 0; i < term_hashes.size(); i++) {
+                size_t frequency = std::count_if(tokens.begin(), tokens.end(),
+                                                 [hash = term_hashes[i]](const TokenPosition& token) { return token.term_hash == hash; });
+                score += static_cast<double>(frequency) / tokens.size() * weights[i];
             }
+            bool ranked = boosts && static_cast<size_t>(result.doc_id) < boosts->size();
+            result.score = ranked ? score * (*boosts)[result.doc_id] : score;
+        }
+    }
 
-            sqlite3_finalize(stmt);
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Basic Search Function to test my stuff ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // The doc-id space is cut into search_shards ranges that are scored in parallel on the
+    // query pool, each keeping its own top k. Ranges are disjoint, so the global top k is the
+    // best k of the union, and only those k documents get their names looked up. When the
+    // deadline passes mid-query the shards return early, and the top k of what they scored is
+    // returned with deadline->expired set.
+    auto Indexer::search(std::string_view query, std::pmr::memory_resource* mr, const idf_map* global_idf,
+                         SearchDeadline* deadline, SearchProfile* profile, SearchHits* hits) -> std::pmr::vector<std::pair<std::pmr::string, double>> {
+        std::pmr::vector<std::pair<std::pmr::string, double>> final_results(mr);
+        std::chrono::steady_clock::time_point stage;
+        if (profile)
+            stage = std::chrono::steady_clock::now();
+
+        std::pmr::string normalized(query, mr);
+        std::pmr::vector<std::string_view> terms = tokenize_query(normalized);
+        if (profile) {
+            profile->tokenize_ms = SearchProfile::since(stage);
+            stage = std::chrono::steady_clock::now();
         }
 
-        for (const auto& entry : document_scores) {
-            final_results.emplace_back(entry.first, entry.second);
+        static const char* const documents_query = "SELECT total_documents FROM stats";
+        static const char* const max_document_query = "SELECT MAX(document_id) FROM documents";
+        static const char* const name_query = "SELECT document_name FROM documents WHERE document_id = ?";
+
+        // Searches read the published store through this worker's own connection, so they never
+        // queue on the writer's connection mutex
+        ReadConnection& connection = reader();
+        sqlite3_stmt* stmt;
+        std::pair<uint32_t, uint32_t> cache_before;
+        if (profile)
+            cache_before = page_cache_counters(connection.handle());
+
+        // Without a coordinator's global IDF, each term is weighted by its IDF in this store
+        long long documents = 0;
+        if (!global_idf) {
+            if ((stmt = connection.statement(documents_query)) && sqlite3_step(stmt) == SQLITE_ROW)
+                documents = sqlite3_column_int64(stmt, 0);
+            if (stmt)
+                sqlite3_reset(stmt);
         }
 
-        std::sort(final_results.begin(), final_results.end(), 
-                [](const auto& a, const auto& b) { return a.second > b.second; });
+        // Expansions of a misspelled term count for less the further they are from it
+        std::pmr::vector<long long> term_ids(mr);
+        std::pmr::vector<double> weights(mr);
+        std::vector<uint32_t> term_hashes;
+        for (const auto& match : match_terms(connection, terms, mr)) {
+            double idf;
+            if (global_idf) {
+                auto it = global_idf->find(match.term);
+                idf = it == global_idf->end() ? 0.0 : it->second;
+            } else {
+                idf = std::log(static_cast<double>(documents) / (match.document_count + 1));  // Add 1 to avoid division by zero
+            }
+            term_ids.push_back(match.term_id);
+            weights.push_back(idf * fuzzy_weight(match.distance));
+            term_hashes.push_back(token_hash(match.term));
+            if (profile)
+                profile->terms.push_back({std::string(match.term), match.document_count, match.distance});
+        }
+        if (profile) {
+            profile->dictionary_ms = SearchProfile::since(stage);
+            add_page_cache(*profile, connection.handle(), cache_before);
+        }
+        if (hits)
+            hits->term_hashes = term_hashes;
+        if (term_ids.empty())
+            return final_results;
+
+        long long max_doc = 0;
+        if ((stmt = connection.statement(max_document_query)) && sqlite3_step(stmt) == SQLITE_ROW)
+            max_doc = sqlite3_column_int64(stmt, 0);
+        if (stmt)
+            sqlite3_reset(stmt);
+        if (max_doc <= 0)
+            return final_results;
+
+        const auto& config = index_stream::Config::get();
+        const size_t top_k = static_cast<size_t>(config.search_top_k);
+        const long long shards = std::min<long long>(config.search_shards, max_doc);
+        const long long span = (max_doc + shards - 1) / shards;
+
+        // Deleted documents stay in the postings until compaction; the shards filter them while
+        // this thread holds the read lock for all of them
+        auto tombstone_lock = tombstones.read_lock();
+        std::shared_ptr<const std::vector<float>> boosts = static_rank_boosts();
+
+        if (profile) {
+            profile->shards = static_cast<size_t>(shards);
+            stage = std::chrono::steady_clock::now();
+        }
 
+        std::vector<ScoredDocument> merged;
+        if (shards == 1) {
+            merged = search_shard(term_ids, weights, 1, max_doc, top_k, deadline, boosts.get(), profile);
+        } else {
+            std::vector<std::future<std::vector<ScoredDocument>>> parts;
+            parts.reserve(shards);
+            for (long long first = 1; first <= max_doc; first += span) {
+                long long last = std::min(max_doc, first + span - 1);
+                parts.push_back(query_pool.submit([this, &term_ids, &weights, &boosts, first, last, top_k, deadline, profile] {
+                    return search_shard(term_ids, weights, first, last, top_k, deadline, boosts.get(), profile);
+                }));
+            }
+            for (auto& part : parts) {
+                auto shard_results = part.get();
+                merged.insert(merged.end(), shard_results.begin(), shard_results.end());
+            }
+        }
+        tombstone_lock.unlock();
+        if (deadline && deadline->expired)
+            timed_out++;
+        if (profile) {
+            profile->scoring_ms = SearchProfile::since(stage);
+            stage = std::chrono::steady_clock::now();
+            cache_before = page_cache_counters(connection.handle());
+        }
+
+        auto by_score = [](const ScoredDocument& a, const ScoredDocument& b) {
+            return a.score != b.score ? a.score > b.score : a.doc_id < b.doc_id;
+        };
+        // Quantized scores tie pages whose tf differs by less than an impact step, so twice the
+        // top k is re-scored exactly before the cut
+        size_t keep = std::min(top_k, merged.size());
+        if (config.impact_index && config.impact_rescore && config.snippets) {
+            size_t pool = std::min(2 * top_k, merged.size());
+            std::partial_sort(merged.begin(), merged.begin() + pool, merged.end(), by_score);
+            merged.resize(pool);
+            rescore_exact(connection, term_hashes, weights, boosts.get(), merged);
+        }
+        std::partial_sort(merged.begin(), merged.begin() + keep, merged.end(), by_score);
+        merged.resize(keep);
+
+        stmt = connection.statement(name_query);
+        if (!stmt)
+            return final_results;
+
+        final_results.reserve(keep);
+        for (const auto& result : merged) {
+            sqlite3_reset(stmt);
+            sqlite3_bind_int64(stmt, 1, result.doc_id);
+            if (sqlite3_step(stmt) == SQLITE_ROW) {
+                std::string_view document_name(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), sqlite3_column_bytes(stmt, 0));
+                final_results.emplace_back(std::pmr::string(document_name, mr), result.score);
+                if (hits)
+                    hits->doc_ids.push_back(result.doc_id);
+            }
+        }
+        sqlite3_reset(stmt);
+
+        if (profile) {
+            profile->rank_ms = SearchProfile::since(stage);
+            add_page_cache(*profile, connection.handle(), cache_before);
+        }
         return final_results;
     }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ corpus size and per-term document counts for a query ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto Indexer::term_statistics(std::string_view query, std::pmr::memory_resource* mr) -> TermStatistics {
+        static const char* const documents_query = "SELECT total_documents FROM stats";
+
+        TermStatistics statistics(mr);
+        std::pmr::string normalized(query, mr);
+        std::pmr::vector<std::string_view> terms = tokenize_query(normalized);
+
+        ReadConnection& connection = reader();
+        sqlite3_stmt* stmt = connection.statement(documents_query);
+        if (!stmt)
+            return statistics;
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            statistics.documents = sqlite3_column_int64(stmt, 0);
+        sqlite3_reset(stmt);
+
+        // Expansions are reported under their own spelling, which is how shards look them up
+        // in the global IDF
+        for (auto& match : match_terms(connection, terms, mr))
+            statistics.document_counts.emplace_back(std::move(match.term), match.document_count);
+        return statistics;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ highlighted excerpts for the top results ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // Only the first snippet_results documents are fetched; the rest get an empty snippet. Their
+    // stored token positions are matched against the term hashes search() matched (fuzzy
+    // expansions included), so neither the dictionary nor the result URLs are looked up again.
+    auto Indexer::snippets(const SearchHits& hits, std::pmr::memory_resource* mr) -> std::pmr::vector<std::pmr::string> {
+        std::pmr::vector<std::pmr::string> excerpts(hits.doc_ids.size(), std::pmr::string(mr), mr);
+        const auto& config = index_stream::Config::get();
+        if (!config.snippets || hits.doc_ids.empty())
+            return excerpts;
+
+        ReadConnection& connection = reader();
+        std::unordered_map<long long, std::string> block_cache;
+        std::vector<TokenPosition> tokens;
+        size_t count = std::min(hits.doc_ids.size(), static_cast<size_t>(std::max(0, config.snippet_results)));
+        for (size_t i = 0; i < count; i++) {
+            std::string_view text;
+            if (DocumentStore::load(connection, hits.doc_ids[i], block_cache, text, tokens))
+                excerpts[i] = make_snippet(text, tokens, hits.term_hashes, mr);
+        }
+        return excerpts;
+    }
 }
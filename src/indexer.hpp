@@ -7,19 +7,137 @@
 #include <unordered_set>
 #include <queue>
 #include <vector>
+#include <array>
 #include <string>
 #include <regex>
 #include <sstream>
+#include <iomanip>
 #include <algorithm>
 #include <thread>
 #include <future>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <string_view>
+#include <memory_resource>
 #include <sqlite3.h>
 
+#include "tokenizer.hpp"
+#include "analyzer.hpp"
+#include "simhash.hpp"
+#include "tombstones.hpp"
+#include "dump_segment.hpp"
+#include "read_connection.hpp"
+#include "threadpool.hpp"
+#include "doc_store.hpp"
+#include "posting_list.hpp"
+#include "score_accumulator.hpp"
+#include "term_table.hpp"
+#include "fuzzy.hpp"
+#include "link_graph.hpp"
+#include "trace.hpp"
+#include "config.hpp"
+
 
 namespace fs = std::filesystem;
 
 namespace indexer {
+
+    // One crawled page handed to the indexer without going through the dump directory
+    struct IngestRecord {
+        std::string url;
+        std::string html;
+    };
+
+    // A document and its summed score, before its name is looked up
+    struct ScoredDocument {
+        long long doc_id;
+        double score;
+    };
+
+    // Deadline for one query, checked cooperatively by every shard while it walks postings.
+    // The first shard to notice the deadline has passed sets expired; the others then stop at
+    // their next check and keep what they have scored so far.
+    struct SearchDeadline {
+        std::chrono::steady_clock::time_point at = std::chrono::steady_clock::time_point::max();
+        std::atomic<bool> expired {false};
+
+        explicit SearchDeadline(std::chrono::milliseconds timeout) {
+            if (timeout.count() > 0)
+                at = std::chrono::steady_clock::now() + timeout;
+        }
+
+        bool passed() {
+            if (expired.load(std::memory_order_relaxed))
+                return true;
+            if (std::chrono::steady_clock::now() < at)
+                return false;
+            expired.store(true, std::memory_order_relaxed);
+            return true;
+        }
+    };
+
+    // Where the time of one search went, filled in only when the caller passes one (profile=1 or
+    // the slow-query log); with none, search() reads no clocks and counts nothing. Shards add
+    // their counts under the mutex once they finish.
+    struct SearchProfile {
+        struct Term {
+            std::string term;
+            long long document_count {};
+            int distance {};          // fuzzy expansions are > 0
+            size_t postings_read {};
+        };
+
+        double search_ms {};      // the whole search call, local or fanned out
+        double tokenize_ms {};
+        double dictionary_ms {};  // term lookup and fuzzy expansion
+        double scoring_ms {};     // shards, wall clock
+        double rank_ms {};        // merge, top k, exact re-scoring and name lookup
+        double snippets_ms {};
+        double render_ms {};
+        double total_ms {};
+        size_t shards {};
+        size_t documents_scored {};
+        long long cache_hits {};    // SQLite page cache of the connections that searched
+        long long cache_misses {};
+        std::vector<Term> terms;
+        std::mutex mutex;
+
+        static double since(std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+
+    // What search() resolved on its way to the results, so snippets() can reuse it instead of
+    // looking the query terms and result URLs up again
+    struct SearchHits {
+        std::pmr::vector<long long> doc_ids;  // parallel to the returned results
+        std::vector<uint32_t> term_hashes;    // every matched term, fuzzy expansions included
+
+        explicit SearchHits(std::pmr::memory_resource* mr = std::pmr::get_default_resource()) : doc_ids(mr) {}
+    };
+
+    // Corpus-wide statistics a coordinator gathers from every shard before scoring, so all
+    // shards rank with the same IDF
+    using idf_map = std::pmr::unordered_map<std::pmr::string, double>;
+
+    struct TermStatistics {
+        long long documents {};
+        std::pmr::vector<std::pair<std::pmr::string, long long>> document_counts;  // analyzed term, df
+
+        explicit TermStatistics(std::pmr::memory_resource* mr) : document_counts(mr) {}
+    };
+
+    // Counters for how much analysis and deduplication save, reset for every indexing run
+    struct IngestStats {
+        long long tokens {};            // tokens produced by the tokenizer
+        long long stopwords {};         // tokens dropped by the stopword filter
+        long long raw_postings {};      // (term, document) pairs had every surface form been indexed
+        long long postings {};          // (term, document) pairs actually written
+        long long duplicates {};        // documents dropped as near-duplicates of an indexed one
+    };
+
     class Indexer {
     public:
         bool cpy = false;
@@ -28,34 +146,96 @@ namespace indexer {
         Indexer(const Indexer&) = delete;
         Indexer& operator=(const Indexer&) = delete;
         void document_parser(const std::string& file_name, std::string& document);
+        void parse_html(std::string content, std::string& document);
         void directory_spider();
         void update_db();
         void merge_db();
-        void update_idf();
-        void index_updater(std::string& document, std::string& url);
+        bool index_updater(std::string& document, std::string& url);
         bool safe_check_cpy();
+        bool delete_document(const std::string& url);
+        void index_batch(const std::vector<std::string>& files);
+        void index_records(std::vector<IngestRecord>& records);
         std::string url_extractor(std::string file_name);
-        std::vector<std::pair<std::string, double>> search(const std::string& query_term);
+        std::pmr::vector<std::pair<std::pmr::string, double>> search(std::string_view query_term, std::pmr::memory_resource* mr = std::pmr::get_default_resource(),
+                                                                     const idf_map* global_idf = nullptr, SearchDeadline* deadline = nullptr,
+                                                                     SearchProfile* profile = nullptr, SearchHits* hits = nullptr);
+        std::pmr::vector<std::pmr::string> snippets(const SearchHits& hits, std::pmr::memory_resource* mr = std::pmr::get_default_resource());
+        TermStatistics term_statistics(std::string_view query, std::pmr::memory_resource* mr = std::pmr::get_default_resource());
+        long long timed_out_queries() const { return timed_out.load(std::memory_order_relaxed); }
 
     private:
         sqlite3* db_; 
         sqlite3* temp_db_;
         std::string dump_dir {};
+        std::string db_path {};
+        std::string temp_db_path {};  // write buffer for the poll-mode rebuild, next to the store
         std::mutex file_mutex;
+        std::mutex ingest_mutex;  // one writer at a time: batches, full rebuilds and deletes
         std::unordered_map<std::string, std::queue<std::pair<std::string, long long>>> term_document_matrix;
         std::unordered_set<std::string> indexed_documents;
-        std::vector<std::string> tokenize_query(const std::string& query);
+        IngestStats ingest_stats {};
+        SimHashIndex fingerprints {index_stream::Config::get().dedup_distance};
+        TombstoneBitmap tombstones;
+        std::vector<long long> reclaimed_documents;  // compacted in the write buffer db, cleared from the bitmap on merge
+        DocumentStore doc_store;
+        std::vector<TokenPosition> token_positions;  // kept tokens of the document being indexed
+        TermTable word_counts;  // analyzed term -> count in the document being indexed
+        std::vector<uint64_t> surface_forms;  // hashes of its raw tokens
+        TermDictionary term_dictionary;  // term -> term_id cache of the terms table
+        std::vector<uint64_t> outlinks;  // hashed outlinks of the document being indexed
+        bool links_changed = false;  // outlinks written since the last PageRank run
+        bool renumbered = false;  // the write buffer's document ids were renumbered, reload on merge
+        std::chrono::steady_clock::time_point ranked_at {};
+        std::mutex rank_mutex;
+        std::shared_ptr<const std::vector<float>> rank_boosts;  // doc id -> static rank score factor, published copy-on-write
+        PostingStore postings;
+        std::atomic<long long> db_generation {0};  // bumped whenever merge_db swaps the store file
+        std::atomic<long long> timed_out {0};  // queries whose deadline passed while scoring
+        index_stream::ThreadPool query_pool {static_cast<size_t>(index_stream::Config::get().search_shards)};
+        // PageRank is bulk work; it must never queue ahead of search shards on query_pool
+        index_stream::ThreadPool rank_pool {index_stream::Config::get().static_rank
+                                            ? static_cast<size_t>(index_stream::Config::get().pagerank_threads) : 0};
+        ReadConnection& reader();
+        std::vector<ScoredDocument> search_shard(const std::pmr::vector<long long>& term_ids, const std::pmr::vector<double>& weights,
+                                                 long long first_doc, long long last_doc, size_t top_k, SearchDeadline* deadline,
+                                                 const std::vector<float>* boosts, SearchProfile* profile);
+        void rescore_exact(ReadConnection& connection, const std::vector<uint32_t>& term_hashes, const std::pmr::vector<double>& weights,
+                           const std::vector<float>* boosts, std::vector<ScoredDocument>& results);
+        void configure_connection(sqlite3* db);
+        std::pmr::vector<std::string_view> tokenize_query(std::pmr::string& query);
+        std::pmr::vector<TermMatch> match_terms(ReadConnection& connection, const std::pmr::vector<std::string_view>& terms,
+                                                std::pmr::memory_resource* mr);
         void create_tables();
         void set_safe_copy(bool cpy_status);
         void execute_sql(const char* query);
         void process_file(const std::string& f_name);
+        void process_segment(const std::string& f_name);
+        void index_document(std::string& url, const std::string& html);
+        template<typename F> void run_batch(F&& body);
+        void flush_batch(sqlite3* db);
         void print_term_document_matrix() const;
-        void insert_term_document_matrix(long long term_id, long long doc_id, long long frequency);
-        void transform_to_persist();
+        void report_ingest_stats() const;
+        void load_fingerprints();
+        void forget_fingerprint(long long doc_id);
+        void add_column_if_missing(const char* table, const char* column, const char* definition);
+        long long find_document(const std::string& document);
+        void migrate_schema();
+        void migrate_row_postings();
+        void migrate_list_segments();
+        void load_tombstones();
+        void remove_postings(long long doc_id);
+        void refresh_total_documents();
+        void update_static_rank();
+        void load_static_ranks();
+        void publish_static_ranks(const std::vector<long long>& doc_ids, const std::vector<double>& ranks);
+        std::shared_ptr<const std::vector<float>> static_rank_boosts();
+        void renumber_documents();
+        void compact();
+        long long total_documents();
         void compute_tf_idf();
         bool close_database();
         bool delete_file(const std::string& file_name);
-        long long get_or_insert_term(const std::string& term);
+        long long get_or_insert_term(std::string_view term, uint64_t hash);
         long long get_or_insert_document(const std::string& document);  
 
 
@@ -64,14 +244,21 @@ namespace indexer {
         void replace_database_file();
 
         Indexer() {
-            dump_dir = "../raw_dump";
+            const auto& config = index_stream::Config::get();
+            dump_dir = config.dump_dir;
+            db_path = config.db_path;
+            fs::path store(db_path);
+            temp_db_path = (store.parent_path() / ("temp_" + store.filename().string())).string();
             std::string index_file = "./index.csv";
             std::cout << "Initializing DB....\n";
-            if (sqlite3_open("../db/document_store.db", &db_) != SQLITE_OK) {
+            if (sqlite3_open(db_path.c_str(), &db_) != SQLITE_OK) {
                 std::cerr << "Cannot open database: " << sqlite3_errmsg(db_) << std::endl;
                 exit(1);
             }
+            configure_connection(db_);
             create_tables();
+            load_tombstones();
+            load_static_ranks();
             std::cout << "Indexer Initiated...." << std::endl;
         }
 
@@ -0,0 +1,270 @@
+#include <sys/inotify.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <climits>
+#include <filesystem>
+#include <iostream>
+
+#include "ingest_watcher.hpp"
+#include "config.hpp"
+#include "trace.hpp"
+
+namespace index_stream {
+
+    IngestWatcher::IngestWatcher(std::string dump_dir) : dump_dir(std::move(dump_dir)) {}
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Singleton static instance ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto IngestWatcher::get_instance() -> IngestWatcher& {
+        static IngestWatcher instance{Config::get().dump_dir};
+        return instance;
+    }
+
+    IngestWatcher::~IngestWatcher() {
+        stop();
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ set up the inotify watch and start both threads ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto IngestWatcher::start() -> bool {
+        if ((inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+            std::cerr << "Error: Failed to initialize inotify: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        // IN_CLOSE_WRITE catches files written in place, IN_MOVED_TO files renamed into the directory
+        if (inotify_add_watch(inotify_fd, dump_dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            std::cerr << "Error: Failed to watch " << dump_dir << ": " << std::strerror(errno) << std::endl;
+            close(inotify_fd);
+            inotify_fd = -1;
+            return false;
+        }
+
+        if (pipe2(wake_pipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+            std::cerr << "Error: Failed to create wake pipe: " << std::strerror(errno) << std::endl;
+            close(inotify_fd);
+            inotify_fd = -1;
+            return false;
+        }
+
+        // Pick up whatever was dumped while the server was down
+        scan_directory();
+
+        watcher = std::thread(&IngestWatcher::watch_loop, this);
+        worker = std::thread(&IngestWatcher::index_loop, this);
+        started = true;
+        std::cout << "Watching " << dump_dir << " for new documents" << std::endl;
+        return true;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ queue posted records, or refuse them when saturated ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto IngestWatcher::submit(std::vector<indexer::IngestRecord>&& records, size_t bytes) -> bool {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (stopping || pending.size() >= static_cast<size_t>(Config::get().ingest_max_pending)) {
+                rejected_submits++;
+                return false;
+            }
+
+            IngestBatch batch {};
+            batch.records = std::move(records);
+            batch.bytes = bytes;
+            batch.first_seen = std::chrono::steady_clock::now();
+            pending.push_back(std::move(batch));
+        }
+        batch_ready.notify_one();
+        return true;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ stop watching, index what is already queued, join ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto IngestWatcher::stop() -> void {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        batch_ready.notify_all();
+        batch_taken.notify_all();
+        if (wake_pipe[1] >= 0)
+            (void)!write(wake_pipe[1], "x", 1);
+
+        if (watcher.joinable())
+            watcher.join();
+        if (worker.joinable())
+            worker.join();
+
+        for (int* fd : {&inotify_fd, &wake_pipe[0], &wake_pipe[1]}) {
+            if (*fd >= 0) {
+                close(*fd);
+                *fd = -1;
+            }
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ queue one file into the open batch ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto IngestWatcher::add_file(const std::string& path) -> void {
+        std::string name = std::filesystem::path(path).filename().string();
+
+        // Hidden files and half-written .tmp files are not documents
+        if (name.empty() || name[0] == '.' || (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0))
+            return;
+
+        std::error_code ec;
+        if (!std::filesystem::is_regular_file(path, ec))
+            return;
+        size_t size = static_cast<size_t>(std::filesystem::file_size(path, ec));
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!queued.insert(path).second)
+            return;
+
+        if (current.files.empty())
+            current.first_seen = std::chrono::steady_clock::now();
+        current.files.push_back(path);
+        current.bytes += ec ? 0 : size;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ queue every file currently in the dump directory ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto IngestWatcher::scan_directory() -> void {
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(dump_dir, ec))
+            add_file(entry.path().string());
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ hand the open batch to the indexer (mutex held) ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto IngestWatcher::cut_batch() -> void {
+        pending.push_back(std::move(current));
+        current = IngestBatch{};
+        batch_ready.notify_one();
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ read all queued inotify events, true if the kernel queue overflowed ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto IngestWatcher::drain_events() -> bool {
+        alignas(inotify_event) char buffer[64 * (sizeof(inotify_event) + NAME_MAX + 1)];
+        bool overflow = false;
+
+        for (;;) {
+            ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+            if (length <= 0)
+                return overflow;
+
+            for (char* ptr = buffer; ptr < buffer + length; ) {
+                const auto* event = reinterpret_cast<const inotify_event*>(ptr);
+                if (event->mask & IN_Q_OVERFLOW)
+                    overflow = true;
+                else if (event->len > 0)
+                    add_file(dump_dir + "/" + event->name);
+                ptr += sizeof(inotify_event) + event->len;
+            }
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ how long poll may sleep before the open batch is due ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto IngestWatcher::poll_timeout_ms() -> int {
+        std::unique_lock<std::mutex> lock(mutex);
+        const auto& config = Config::get();
+
+        // Nothing to publish, or nowhere to put it: sleep until an event or the indexer wakes us
+        if (current.files.empty() || pending.size() >= static_cast<size_t>(config.ingest_max_pending))
+            return -1;
+
+        auto due = current.first_seen + std::chrono::milliseconds(config.ingest_latency_ms);
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(due - std::chrono::steady_clock::now()).count();
+        return left > 0 ? static_cast<int>(left) : 0;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ collect events and cut batches by size or age ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto IngestWatcher::watch_loop() -> void {
+        Tracer::get_instance().name_thread("ingest-watch");
+        const auto& config = Config::get();
+        const size_t max_pending = static_cast<size_t>(config.ingest_max_pending);
+        const size_t batch_bytes = static_cast<size_t>(config.ingest_batch_bytes);
+        const auto latency = std::chrono::milliseconds(config.ingest_latency_ms);
+
+        for (;;) {
+            {
+                // Backpressure: while the indexer is behind, the open batch keeps growing up to
+                // batch_bytes, then we stop draining inotify altogether
+                std::unique_lock<std::mutex> lock(mutex);
+                if (pending.size() >= max_pending && current.bytes >= batch_bytes) {
+                    backpressure_waits++;
+                    std::cout << "Indexer behind (" << pending.size() << " batches pending), pausing ingest" << std::endl;
+                    batch_taken.wait(lock, [this, max_pending] { return stopping || pending.size() < max_pending; });
+                }
+                if (stopping)
+                    return;
+            }
+
+            pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {wake_pipe[0], POLLIN, 0}};
+            if (poll(fds, 2, poll_timeout_ms()) < 0 && errno != EINTR) {
+                std::cerr << "Error: poll on inotify failed: " << std::strerror(errno) << std::endl;
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                continue;
+            }
+
+            if (fds[1].revents & POLLIN) {
+                char drain[64];
+                while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {}
+            }
+
+            if ((fds[0].revents & POLLIN) && drain_events()) {
+                std::cerr << "inotify queue overflowed, rescanning " << dump_dir << std::endl;
+                scan_directory();
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            if (stopping)
+                return;
+            bool due = !current.files.empty() &&
+                       (current.bytes >= batch_bytes || std::chrono::steady_clock::now() - current.first_seen >= latency);
+            if (due && pending.size() < max_pending)
+                cut_batch();
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ index and publish batches one at a time ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto IngestWatcher::index_loop() -> void {
+        Tracer::get_instance().name_thread("ingest-index");
+        auto& idxr = indexer::Indexer::get_instance();
+
+        for (;;) {
+            IngestBatch batch;
+            size_t still_pending {};
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                batch_ready.wait(lock, [this] { return stopping || !pending.empty(); });
+                if (pending.empty())
+                    return;
+                batch = std::move(pending.front());
+                pending.pop_front();
+                still_pending = pending.size();
+            }
+            batch_taken.notify_all();
+            (void)!write(wake_pipe[1], "x", 1);
+
+            auto began = std::chrono::steady_clock::now();
+            if (!batch.files.empty())
+                idxr.index_batch(batch.files);
+            else
+                idxr.index_records(batch.records);
+            auto published = std::chrono::steady_clock::now();
+            size_t documents = batch.files.size() + batch.records.size();
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                for (const auto& file : batch.files)
+                    queued.erase(file);
+            }
+
+            auto index_ms = std::chrono::duration_cast<std::chrono::milliseconds>(published - began).count();
+            auto latency_ms = std::chrono::duration_cast<std::chrono::milliseconds>(published - batch.first_seen).count();
+            std::cout << "Published batch: " << documents << (batch.files.empty() ? " posted records, " : " files, ")
+                      << batch.bytes / 1024 << " KiB in "
+                      << index_ms << " ms (" << (index_ms > 0 ? documents * 1000 / index_ms : documents) << " docs/s), "
+                      << "latency " << latency_ms << " ms, " << still_pending << " pending, "
+                      << backpressure_waits.load() << " backpressure pauses, "
+                      << rejected_submits.load() << " rejected posts" << std::endl;
+            Tracer::get_instance().export_trace();
+        }
+    }
+}
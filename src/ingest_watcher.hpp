@@ -0,0 +1,78 @@
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <unordered_set>
+
+#include "indexer.hpp"
+
+#ifndef RFSS_INGEST_WATCHER_HPP
+#define RFSS_INGEST_WATCHER_HPP
+
+namespace index_stream {
+
+    // Files collected from the dump directory, or records posted to /ingest, that get indexed
+    // and published together
+    struct IngestBatch {
+        std::vector<std::string> files;
+        std::vector<indexer::IngestRecord> records;
+        size_t bytes {};
+        std::chrono::steady_clock::time_point first_seen {};
+    };
+
+    // Watches the dump directory with inotify and feeds new files to the indexer in micro-batches.
+    // A batch is cut when it reaches ingest_batch_bytes (throughput) or when its oldest file has
+    // waited ingest_latency_ms (latency). Cut batches queue for a single indexing thread; once
+    // ingest_max_pending are waiting the watcher stops draining inotify until the indexer catches
+    // up, and rescans the directory if the kernel queue overflowed in the meantime.
+    // Pages posted to /ingest skip the directory and join the same queue through submit().
+    class IngestWatcher {
+    public:
+        static IngestWatcher& get_instance();
+        ~IngestWatcher();
+        IngestWatcher(const IngestWatcher&) = delete;
+        IngestWatcher& operator=(const IngestWatcher&) = delete;
+
+        bool start();  // false if inotify is not available
+        void stop();
+        bool running() const { return started; }
+
+        // Queues records as their own batch. Returns false without taking them when the
+        // indexer is saturated, so the caller can push back on the client.
+        bool submit(std::vector<indexer::IngestRecord>&& records, size_t bytes);
+
+    private:
+        explicit IngestWatcher(std::string dump_dir);
+        std::string dump_dir;
+        int inotify_fd {-1};
+        int wake_pipe[2] {-1, -1};
+        std::thread watcher;
+        std::thread worker;
+
+        std::mutex mutex;
+        std::condition_variable batch_ready;
+        std::condition_variable batch_taken;
+        std::deque<IngestBatch> pending;
+        IngestBatch current;
+        std::unordered_set<std::string> queued;  // files in a batch that has not been indexed yet
+        bool stopping {};
+        std::atomic<bool> started {false};
+
+        std::atomic<long long> backpressure_waits {0};
+        std::atomic<long long> rejected_submits {0};
+
+        void watch_loop();
+        void index_loop();
+        void scan_directory();
+        void add_file(const std::string& path);
+        void cut_batch();
+        bool drain_events();
+        int poll_timeout_ms();
+    };
+}
+
+#endif
@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <unordered_map>
+
+#include "link_graph.hpp"
+#include "simhash.hpp"
+#include "trace.hpp"
+
+namespace indexer {
+
+    auto url_key(std::string_view url) -> uint64_t {
+        return hash_term(url);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ case-insensitive search for an ASCII needle ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    static size_t find_nocase(std::string_view haystack, std::string_view needle, size_t from) {
+        auto lower = [](char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + 32) : c; };
+        for (size_t i = from; i + needle.size() <= haystack.size(); i++) {
+            size_t j = 0;
+            while (j < needle.size() && lower(haystack[i + j]) == needle[j])
+                j++;
+            if (j == needle.size())
+                return i;
+        }
+        return std::string_view::npos;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ href value -> absolute URL, empty if it is not a web link ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    static std::string resolve_url(std::string_view href, std::string_view page_url) {
+        size_t fragment = href.find('#');
+        if (fragment != std::string_view::npos)
+            href = href.substr(0, fragment);
+        while (!href.empty() && (href.front() == ' ' || href.front() == '\t' || href.front() == '\n'))
+            href.remove_prefix(1);
+        while (!href.empty() && (href.back() == ' ' || href.back() == '\t' || href.back() == '\n'))
+            href.remove_suffix(1);
+        if (href.empty())
+            return {};
+
+        std::string link;
+        for (size_t i = 0; i < href.size(); i++) {
+            if (href.compare(i, 5, "&amp;") == 0) {
+                link += '&';
+                i += 4;
+            } else {
+                link += href[i];
+            }
+        }
+
+        if (find_nocase(link, "http://", 0) == 0 || find_nocase(link, "https://", 0) == 0)
+            return link;
+
+        // Any other scheme (mailto:, javascript:, ...) before the first path separator
+        size_t colon = link.find(':');
+        if (colon != std::string::npos && link.find_first_of("/?") > colon)
+            return {};
+
+        size_t scheme_end = page_url.find("://");
+        if (scheme_end == std::string_view::npos)
+            return {};
+        size_t path_start = page_url.find('/', scheme_end + 3);
+        std::string_view origin = page_url.substr(0, path_start);
+
+        if (link.compare(0, 2, "//") == 0)
+            return std::string(page_url.substr(0, scheme_end + 1)) + link;
+        if (link.front() == '/')
+            return std::string(origin) + link;
+        if (link.front() == '?')
+            return std::string(page_url.substr(0, page_url.find('?'))) + link;
+
+        // Relative to the page's directory
+        std::string_view path = path_start == std::string_view::npos ? std::string_view("/") : page_url.substr(path_start);
+        path = path.substr(0, path.find('?'));
+        path = path.substr(0, path.rfind('/') + 1);
+        if (link.compare(0, 2, "./") == 0)
+            link.erase(0, 2);
+        return std::string(origin) + std::string(path) + link;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ pull the href of every anchor out of a raw page ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto extract_links(std::string_view html, std::string_view page_url) -> std::vector<uint64_t> {
+        std::vector<uint64_t> links;
+        const uint64_t self = url_key(page_url);
+
+        size_t position = 0;
+        while ((position = find_nocase(html, "<a", position)) != std::string_view::npos) {
+            position += 2;
+            if (position >= html.size())
+                break;
+            char after = html[position];
+            if (after != ' ' && after != '\t' && after != '\n' && after != '\r')
+                continue;  // <abbr>, <area>, ...
+
+            size_t tag_end = html.find('>', position);
+            if (tag_end == std::string_view::npos)
+                break;
+            std::string_view tag = html.substr(position, tag_end - position);
+            position = tag_end + 1;
+
+            size_t attribute = find_nocase(tag, "href", 0);
+            if (attribute == std::string_view::npos)
+                continue;
+            size_t value = tag.find_first_not_of(" \t\n\r", attribute + 4);
+            if (value == std::string_view::npos || tag[value] != '=')
+                continue;
+            value = tag.find_first_not_of(" \t\n\r", value + 1);
+            if (value == std::string_view::npos)
+                continue;
+
+            std::string_view href;
+            if (tag[value] == '"' || tag[value] == '\'') {
+                size_t close = tag.find(tag[value], value + 1);
+                if (close == std::string_view::npos)
+                    continue;
+                href = tag.substr(value + 1, close - value - 1);
+            } else {
+                size_t end = tag.find_first_of(" \t\n\r", value);
+                href = tag.substr(value, end == std::string_view::npos ? std::string_view::npos : end - value);
+            }
+
+            std::string url = resolve_url(href, page_url);
+            if (url.empty())
+                continue;
+            uint64_t key = url_key(url);
+            if (key != self)
+                links.push_back(key);
+        }
+
+        std::sort(links.begin(), links.end());
+        links.erase(std::unique(links.begin(), links.end()), links.end());
+        return links;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ outlink table ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto create_link_table(sqlite3* db) -> void {
+        const char* create_links_table = R"(
+            CREATE TABLE IF NOT EXISTS document_links (
+                document_id INTEGER PRIMARY KEY,
+                targets BLOB, -- url_key of every distinct outlink, 8 bytes each
+                FOREIGN KEY (document_id) REFERENCES documents(document_id)
+            );
+        )";
+
+        char* errmsg = nullptr;
+        if (sqlite3_exec(db, create_links_table, nullptr, nullptr, &errmsg) != SQLITE_OK) {
+            std::cerr << "SQL error: " << errmsg << std::endl;
+            sqlite3_free(errmsg);
+        }
+    }
+
+    auto write_links(sqlite3* db, long long doc_id, const std::vector<uint64_t>& targets) -> void {
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO document_links (document_id, targets) VALUES (?, ?);", -1, &stmt, nullptr);
+        sqlite3_bind_int64(stmt, 1, doc_id);
+        sqlite3_bind_blob(stmt, 2, targets.data(), static_cast<int>(targets.size() * sizeof(uint64_t)), SQLITE_STATIC);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+            std::cerr << "Failed to store document links: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_finalize(stmt);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ resolve stored outlinks to nodes and transpose into CSR ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto LinkGraph::load(sqlite3* db) -> LinkGraph {
+        LinkGraph graph;
+        sqlite3_stmt* stmt;
+        std::unordered_map<uint64_t, uint32_t> nodes_by_url;
+
+        sqlite3_prepare_v2(db, "SELECT document_id, document_name FROM documents ORDER BY document_id;", -1, &stmt, nullptr);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            std::string_view name(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)), sqlite3_column_bytes(stmt, 1));
+            nodes_by_url.emplace(url_key(name), static_cast<uint32_t>(graph.doc_ids.size()));
+            graph.doc_ids.push_back(sqlite3_column_int64(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+
+        auto node_of = [&graph](long long doc_id) -> long long {
+            auto it = std::lower_bound(graph.doc_ids.begin(), graph.doc_ids.end(), doc_id);
+            return (it != graph.doc_ids.end() && *it == doc_id) ? it - graph.doc_ids.begin() : -1;
+        };
+
+        sqlite3_prepare_v2(db, "SELECT alias, document_id FROM document_aliases;", -1, &stmt, nullptr);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            std::string_view alias(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), sqlite3_column_bytes(stmt, 0));
+            long long node = node_of(sqlite3_column_int64(stmt, 1));
+            if (node >= 0)
+                nodes_by_url.emplace(url_key(alias), static_cast<uint32_t>(node));
+        }
+        sqlite3_finalize(stmt);
+
+        // (target, source) pairs, so sorting groups them the way the transposed rows are laid out
+        std::vector<std::pair<uint32_t, uint32_t>> edges;
+        std::vector<uint32_t> targets;
+        graph.out_degree.assign(graph.nodes(), 0);
+        sqlite3_prepare_v2(db, "SELECT document_id, targets FROM document_links;", -1, &stmt, nullptr);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            long long source = node_of(sqlite3_column_int64(stmt, 0));
+            if (source < 0)
+                continue;
+            const char* data = static_cast<const char*>(sqlite3_column_blob(stmt, 1));
+            size_t count = static_cast<size_t>(sqlite3_column_bytes(stmt, 1)) / sizeof(uint64_t);
+
+            targets.clear();
+            for (size_t i = 0; i < count; i++) {
+                uint64_t key;
+                std::memcpy(&key, data + i * sizeof(key), sizeof(key));
+                auto target = nodes_by_url.find(key);
+                if (target != nodes_by_url.end() && target->second != static_cast<uint32_t>(source))
+                    targets.push_back(target->second);
+            }
+            // Two URLs of one page (an alias and the original) are still one link
+            std::sort(targets.begin(), targets.end());
+            targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+
+            graph.out_degree[source] = static_cast<uint32_t>(targets.size());
+            for (uint32_t target : targets)
+                edges.emplace_back(target, static_cast<uint32_t>(source));
+        }
+        sqlite3_finalize(stmt);
+
+        std::sort(edges.begin(), edges.end());
+        graph.in_offsets.assign(graph.nodes() + 1, 0);
+        graph.in_sources.reserve(edges.size());
+        for (const auto& [target, source] : edges) {
+            graph.in_offsets[target + 1]++;
+            graph.in_sources.push_back(source);
+        }
+        for (size_t node = 0; node < graph.nodes(); node++)
+            graph.in_offsets[node + 1] += graph.in_offsets[node];
+        return graph;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ run body over [0, n) in one range per pool thread plus the caller, summing what each returns ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    template<typename F>
+    static double parallel_sum(index_stream::ThreadPool& pool, size_t n, F&& body) {
+        size_t parts = std::min(pool.size() + 1, n / 1024 + 1);
+        size_t span = (n + parts - 1) / parts;
+        std::vector<std::future<double>> futures;
+        for (size_t begin = span; begin < n; begin += span)
+            futures.push_back(pool.submit([&body, begin, end = std::min(n, begin + span)] {
+                index_stream::TraceSpan trace("pagerank_range", "rank");
+                return body(begin, end);
+            }));
+
+        double sum;
+        {
+            index_stream::TraceSpan trace("pagerank_range", "rank");
+            sum = body(0, std::min(n, span));  // first range on the calling thread
+        }
+        for (auto& future : futures)
+            sum += future.get();
+        return sum;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ power iteration ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto compute_pagerank(const LinkGraph& graph, index_stream::ThreadPool& pool, int max_iterations,
+                          double tolerance, double damping) -> PageRankResult {
+        PageRankResult result;
+        const size_t n = graph.nodes();
+        if (n == 0)
+            return result;
+
+        result.ranks.assign(n, 1.0 / static_cast<double>(n));
+        std::vector<double> next(n), contribution(n);
+        for (int iteration = 0; iteration < max_iterations; iteration++) {
+            // Each page's share per outlink; pages without outlinks pool theirs
+            double dangling = parallel_sum(pool, n, [&](size_t begin, size_t end) {
+                double lost = 0.0;
+                for (size_t node = begin; node < end; node++) {
+                    if (graph.out_degree[node] == 0) {
+                        contribution[node] = 0.0;
+                        lost += result.ranks[node];
+                    } else {
+                        contribution[node] = result.ranks[node] / graph.out_degree[node];
+                    }
+                }
+                return lost;
+            });
+
+            const double base = (1.0 - damping + damping * dangling) / static_cast<double>(n);
+            double delta = parallel_sum(pool, n, [&](size_t begin, size_t end) {
+                double change = 0.0;
+                for (size_t node = begin; node < end; node++) {
+                    double incoming = 0.0;
+                    for (uint64_t i = graph.in_offsets[node]; i < graph.in_offsets[node + 1]; i++)
+                        incoming += contribution[graph.in_sources[i]];
+                    next[node] = base + damping * incoming;
+                    change += std::fabs(next[node] - result.ranks[node]);
+                }
+                return change;
+            });
+
+            result.ranks.swap(next);
+            result.iterations = iteration + 1;
+            result.delta = delta;
+            if (delta < tolerance)
+                break;
+        }
+        return result;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sqlite3.h>
+
+#include "threadpool.hpp"
+
+namespace indexer {
+
+    // Outlinks of a page, as hashes of their absolute URLs (fragment dropped, resolved against
+    // the page URL), deduplicated and without self-links. Pages are matched to link targets by
+    // the same hash of their document_name.
+    std::vector<uint64_t> extract_links(std::string_view html, std::string_view page_url);
+    uint64_t url_key(std::string_view url);
+
+    // document_links(document_id, targets): the outlink hashes of every indexed page
+    void create_link_table(sqlite3* db);
+    void write_links(sqlite3* db, long long doc_id, const std::vector<uint64_t>& targets);
+
+    // Link graph over the indexed documents in compressed sparse row form, transposed so each
+    // node lists the nodes linking to it: PageRank then pulls contributions, and every node is
+    // written by exactly one thread. Links to pages that are not indexed are dropped; links to
+    // a collapsed duplicate count for the page it was collapsed into.
+    struct LinkGraph {
+        std::vector<long long> doc_ids;     // node -> document id, ascending
+        std::vector<uint32_t> out_degree;   // resolved outlinks per node
+        std::vector<uint64_t> in_offsets;   // node -> first entry in in_sources, size nodes + 1
+        std::vector<uint32_t> in_sources;   // nodes linking to each node, grouped by target
+
+        static LinkGraph load(sqlite3* db);
+        size_t nodes() const { return doc_ids.size(); }
+        size_t edges() const { return in_sources.size(); }
+    };
+
+    struct PageRankResult {
+        std::vector<double> ranks;  // per node, summing to 1
+        int iterations {};
+        double delta {};            // L1 change of the last iteration
+    };
+
+    // Power iteration with uniform teleport; the rank of dangling pages is spread over all
+    // pages. Nodes are split into one contiguous range per pool thread, plus one for the calling
+    // thread, for both phases of an iteration. Stops after max_iterations or once the L1 change drops below tolerance.
+    PageRankResult compute_pagerank(const LinkGraph& graph, index_stream::ThreadPool& pool,
+                                    int max_iterations, double tolerance, double damping);
+}
@@ -1,7 +1,7 @@
 #include "server.hpp"
 
 auto main() -> int {
-    index_stream::HTTP_Server server(8080);
+    index_stream::HTTP_Server server(index_stream::Config::get().port);
     server.start();
     return 0;
 }
\ No newline at end of file
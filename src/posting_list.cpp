@@ -0,0 +1,734 @@
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <queue>
+
+#include "posting_list.hpp"
+#include "config.hpp"
+
+namespace indexer {
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ LEB128 varints ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    static void put_varint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    static bool get_varint(std::string_view data, size_t& position, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && position < data.size(); shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(data[position++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    template<typename T>
+    static void put_fixed(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template<typename T>
+    static T get_fixed(const char* data) {
+        T value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    const size_t HEADER_BYTES = 8;
+    const size_t SKIP_BYTES = 16;
+
+    // Octaves of tf covered by the 255 impact levels
+    const double IMPACT_OCTAVES = 16.0;
+
+    auto quantize_impact(uint32_t frequency, uint32_t length) -> uint8_t {
+        if (frequency == 0 || length == 0)
+            return 1;
+        double level = 255.0 + 255.0 / IMPACT_OCTAVES * std::log2(static_cast<double>(frequency) / length);
+        return static_cast<uint8_t>(std::clamp(std::lround(level), 1L, 255L));
+    }
+
+    auto impact_tf(uint8_t impact) -> double {
+        return std::exp2((static_cast<double>(impact) - 255.0) * IMPACT_OCTAVES / 255.0);
+    }
+
+    PostingCursor::~PostingCursor() {
+        for (auto& generation : generations)
+            if (generation.blob)
+                sqlite3_blob_close(generation.blob);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ find a term's segments and read each generation's first skip table ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto PostingCursor::open(sqlite3* db, long long term_id, long long from_generation, sqlite3_stmt* segments) -> bool {
+        this->db = db;
+        sqlite3_stmt* stmt = segments;
+        if (!stmt && sqlite3_prepare_v2(db, SEGMENTS_QUERY, -1, &stmt, nullptr) != SQLITE_OK)
+            return false;
+
+        sqlite3_bind_int64(stmt, 1, term_id);
+        sqlite3_bind_int64(stmt, 2, from_generation);
+        long long current = 0;
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            long long number = sqlite3_column_int64(stmt, 1);
+            if (generations.empty() || number != current)
+                generations.emplace_back();
+            current = number;
+            generations.back().segments.emplace_back(sqlite3_column_int64(stmt, 0), sqlite3_column_int64(stmt, 2));
+        }
+        if (segments) {
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+        } else {
+            sqlite3_finalize(stmt);
+        }
+
+        // A generation that cannot be read is skipped rather than losing the whole list. Inside
+        // the caller's transaction the listed segments cannot be merged away in the meantime.
+        for (auto& generation : generations)
+            generation.exhausted = !open_segment(generation, 0);
+        return !generations.empty();
+    }
+
+    auto PostingCursor::impacts() const -> bool {
+        return std::any_of(generations.begin(), generations.end(), [](const Generation& generation) { return generation.impact_list; });
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ point a generation at one of its segment BLOBs ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto PostingCursor::open_segment(Generation& generation, size_t index) -> bool {
+        generation.segment = index;
+        generation.skips.clear();
+        generation.next_block = 0;
+        generation.left = 0;
+
+        long long segment_id = generation.segments[index].first;
+        int rc = generation.blob ? sqlite3_blob_reopen(generation.blob, segment_id)
+                                 : sqlite3_blob_open(db, "main", "posting_segments", "data", segment_id, 0, &generation.blob);
+        if (rc != SQLITE_OK) {
+            if (generation.blob)
+                sqlite3_blob_close(generation.blob);
+            generation.blob = nullptr;
+            return false;
+        }
+
+        int size = sqlite3_blob_bytes(generation.blob);
+        char header[HEADER_BYTES];
+        if (size < static_cast<int>(HEADER_BYTES) || sqlite3_blob_read(generation.blob, header, HEADER_BYTES, 0) != SQLITE_OK)
+            return false;
+
+        uint32_t block_count = get_fixed<uint32_t>(header + 4);
+        generation.impact_list = block_count & IMPACT_LIST;
+        block_count &= ~IMPACT_LIST;
+        generation.data_start = HEADER_BYTES + static_cast<size_t>(block_count) * SKIP_BYTES;
+        if (generation.data_start > static_cast<size_t>(size))
+            return false;
+
+        std::string table(static_cast<size_t>(block_count) * SKIP_BYTES, '\0');
+        if (!table.empty() && sqlite3_blob_read(generation.blob, table.data(), static_cast<int>(table.size()), HEADER_BYTES) != SQLITE_OK)
+            return false;
+
+        generation.skips.resize(block_count);
+        for (uint32_t i = 0; i < block_count; i++) {
+            const char* entry = table.data() + i * SKIP_BYTES;
+            generation.skips[i] = {get_fixed<int64_t>(entry), get_fixed<uint32_t>(entry + 8), get_fixed<uint32_t>(entry + 12)};
+        }
+        return true;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ binary search each generation for the first block ending at or after doc_id ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto PostingCursor::seek(long long doc_id) -> void {
+        for (auto& generation : generations) {
+            generation.has_head = false;
+            auto segment = std::lower_bound(generation.segments.begin(), generation.segments.end(), doc_id,
+                                            [](const std::pair<long long, long long>& entry, long long id) { return entry.second < id; });
+            size_t index = static_cast<size_t>(segment - generation.segments.begin());
+            generation.exhausted = segment == generation.segments.end() ||
+                                   ((index != generation.segment || !generation.blob) && !open_segment(generation, index));
+            if (generation.exhausted)
+                continue;
+
+            auto it = std::lower_bound(generation.skips.begin(), generation.skips.end(), doc_id,
+                                       [](const SkipEntry& entry, long long id) { return entry.last_doc < id; });
+            generation.next_block = static_cast<size_t>(it - generation.skips.begin());
+            generation.left = 0;
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ read one block's bytes out of the segment BLOB ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto PostingCursor::load_block(Generation& generation, size_t index) -> bool {
+        const auto& skips = generation.skips;
+        size_t begin = generation.data_start + skips[index].offset;
+        size_t end = index + 1 < skips.size() ? generation.data_start + skips[index + 1].offset
+                                              : static_cast<size_t>(sqlite3_blob_bytes(generation.blob));
+        if (end < begin)
+            return false;
+
+        generation.block.resize(end - begin);
+        if (sqlite3_blob_read(generation.blob, generation.block.data(), static_cast<int>(generation.block.size()), static_cast<int>(begin)) != SQLITE_OK)
+            return false;
+
+        generation.position = 0;
+        generation.left = skips[index].count;
+        generation.previous = index > 0 ? skips[index - 1].last_doc : 0;
+        return true;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ decode a generation's next posting into its head ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto PostingCursor::advance(Generation& generation) -> bool {
+        while (generation.left == 0) {
+            if (generation.next_block < generation.skips.size()) {
+                if (!load_block(generation, generation.next_block))
+                    return false;
+                generation.next_block++;
+            } else if (generation.segment + 1 >= generation.segments.size() || !open_segment(generation, generation.segment + 1)) {
+                return false;
+            }
+        }
+
+        const std::string& block = generation.block;
+        size_t& position = generation.position;
+        uint64_t delta, frequency, length;
+        bool read = get_varint(block, position, delta) &&
+                    (generation.impact_list ? position < block.size() : get_varint(block, position, frequency) && get_varint(block, position, length));
+        if (!read)
+            return false;
+        generation.left--;
+        generation.previous += static_cast<long long>(delta);
+        if (generation.impact_list)
+            generation.head = {generation.previous, 0, 0, static_cast<uint8_t>(block[position++])};
+        else
+            generation.head = {generation.previous, static_cast<uint32_t>(frequency), static_cast<uint32_t>(length)};
+        return true;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ lowest doc id across the generations, the newest one's posting for it ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto PostingCursor::next(Posting& posting, bool keep_removed) -> bool {
+        while (true) {
+            Generation* newest = nullptr;
+            for (auto& generation : generations) {
+                if (!generation.has_head) {
+                    if (generation.exhausted)
+                        continue;
+                    generation.has_head = advance(generation);
+                    generation.exhausted = !generation.has_head;
+                    if (generation.exhausted)
+                        continue;
+                }
+                // Generations are oldest first, so a tie goes to the later one
+                if (!newest || generation.head.doc_id <= newest->head.doc_id)
+                    newest = &generation;
+            }
+            if (!newest)
+                return false;
+
+            posting = newest->head;
+            for (auto& generation : generations)
+                if (generation.has_head && generation.head.doc_id == posting.doc_id)
+                    generation.has_head = false;
+            if (keep_removed || !posting.removed())
+                return true;
+        }
+    }
+
+    auto PostingCursor::read(Posting* postings, size_t capacity) -> size_t {
+        size_t count = 0;
+        while (count < capacity && next(postings[count]))
+            count++;
+        return count;
+    }
+
+    SegmentWriter::SegmentWriter(sqlite3* db, long long term_id, long long generation, bool impacts)
+        : db(db), term_id(term_id), generation(generation), impacts(impacts) {}
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ encode one posting into the open block ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto SegmentWriter::add(const Posting& posting) -> void {
+        if (in_block == 0)
+            block_start = static_cast<uint32_t>(blocks.size());
+
+        put_varint(blocks, static_cast<uint64_t>(posting.doc_id - previous));
+        if (impacts) {
+            uint8_t impact = posting.removed() ? 0 : posting.impact ? posting.impact : quantize_impact(posting.frequency, posting.length);
+            blocks.push_back(static_cast<char>(impact));
+        } else {
+            put_varint(blocks, posting.frequency);
+            put_varint(blocks, posting.length);
+        }
+        previous = posting.doc_id;
+        count++;
+        if (!posting.removed())
+            live_postings++;
+        if (++in_block == POSTING_BLOCK_SIZE) {
+            close_block();
+            if (skips.size() / SKIP_BYTES == POSTING_SEGMENT_BLOCKS)
+                write_segment();
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ complete the open block's skip entry ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto SegmentWriter::close_block() -> void {
+        put_fixed<int64_t>(skips, previous);
+        put_fixed<uint32_t>(skips, block_start);
+        put_fixed<uint32_t>(skips, in_block);
+        in_block = 0;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ store the encoded blocks as one segment row and start the next ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto SegmentWriter::write_segment() -> void {
+        if (in_block)
+            close_block();
+        if (count == 0)
+            return;
+
+        uint32_t block_count = static_cast<uint32_t>(skips.size() / SKIP_BYTES);
+        std::string data;
+        data.reserve(HEADER_BYTES + skips.size() + blocks.size());
+        put_fixed<uint32_t>(data, count);
+        put_fixed<uint32_t>(data, impacts ? block_count | IMPACT_LIST : block_count);
+        data += skips;
+        data += blocks;
+
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, "INSERT INTO posting_segments (term_id, generation, last_doc, impacts, data) VALUES (?, ?, ?, ?, ?);", -1, &stmt, nullptr);
+        sqlite3_bind_int64(stmt, 1, term_id);
+        sqlite3_bind_int64(stmt, 2, generation);
+        sqlite3_bind_int64(stmt, 3, previous);
+        sqlite3_bind_int(stmt, 4, impacts ? 1 : 0);
+        sqlite3_bind_blob(stmt, 5, data.data(), static_cast<int>(data.size()), SQLITE_TRANSIENT);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+            std::cerr << "Failed to write postings: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_finalize(stmt);
+
+        skips.clear();
+        blocks.clear();
+        count = 0;
+        previous = 0;
+    }
+
+    auto SegmentWriter::finish() -> void {
+        write_segment();
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ posting segment, merge queue and forward list tables ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto PostingStore::create_tables(sqlite3* db) -> void {
+        const char* create_segments_table = R"(
+            CREATE TABLE IF NOT EXISTS posting_segments (
+                segment_id INTEGER PRIMARY KEY, -- rowid, so the segment can be opened as a BLOB handle
+                term_id INTEGER NOT NULL,
+                generation INTEGER NOT NULL, -- per term, the newest generation wins for a document
+                last_doc INTEGER NOT NULL, -- a generation's segments cover ascending, disjoint doc-id ranges
+                impacts INTEGER DEFAULT 0, -- 1 if data holds impacts, so writers can tell without opening it
+                data BLOB, -- skip table and varint-coded (or impact) blocks, see SegmentWriter
+                FOREIGN KEY (term_id) REFERENCES terms(term_id)
+            );
+        )";
+
+        const char* create_segments_index = R"(
+            CREATE INDEX IF NOT EXISTS idx_posting_segments_term ON posting_segments (term_id, generation, last_doc);
+        )";
+
+        const char* create_merges_table = R"(
+            CREATE TABLE IF NOT EXISTS posting_merges (
+                term_id INTEGER PRIMARY KEY -- list with more generations than INDEXSTREAM_POSTING_GENERATIONS
+            );
+        )";
+
+        const char* create_document_terms_table = R"(
+            CREATE TABLE IF NOT EXISTS document_terms (
+                document_id INTEGER PRIMARY KEY,
+                term_ids BLOB, -- sorted term ids of the document, varint deltas
+                FOREIGN KEY (document_id) REFERENCES documents(document_id)
+            );
+        )";
+
+        for (const char* query : {create_segments_table, create_segments_index, create_merges_table, create_document_terms_table}) {
+            char* errmsg = nullptr;
+            if (sqlite3_exec(db, query, nullptr, nullptr, &errmsg) != SQLITE_OK) {
+                std::cerr << "SQL error: " << errmsg << std::endl;
+                sqlite3_free(errmsg);
+            }
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ store one term's whole list as a single generation, and its document count ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto PostingStore::write_list(sqlite3* db, long long term_id, const std::vector<Posting>& postings) -> void {
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, "DELETE FROM posting_segments WHERE term_id = ?;", -1, &stmt, nullptr);
+        sqlite3_bind_int64(stmt, 1, term_id);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+            std::cerr << "Failed to write postings: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_finalize(stmt);
+
+        // A list that has been quantized once has no exact values left to store
+        bool impacts = index_stream::Config::get().impact_index ||
+                       std::any_of(postings.begin(), postings.end(), [](const Posting& posting) { return posting.impact != 0; });
+        SegmentWriter writer(db, term_id, 1, impacts);
+        for (const auto& posting : postings)
+            writer.add(posting);
+        writer.finish();
+
+        // The list length is the term's document frequency
+        sqlite3_prepare_v2(db, "UPDATE terms SET document_count = ? WHERE term_id = ?;", -1, &stmt, nullptr);
+        sqlite3_bind_int64(stmt, 1, writer.live());
+        sqlite3_bind_int64(stmt, 2, term_id);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+            std::cerr << "Failed to update document count: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_finalize(stmt);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ an old single-row list BLOB is already a valid segment ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto PostingStore::import_list(sqlite3* db, long long term_id, std::string_view data) -> void {
+        if (data.size() < HEADER_BYTES)
+            return;
+        uint32_t block_count = get_fixed<uint32_t>(data.data() + 4);
+        bool impacts = block_count & IMPACT_LIST;
+        block_count &= ~IMPACT_LIST;
+        if (block_count == 0 || HEADER_BYTES + static_cast<size_t>(block_count) * SKIP_BYTES > data.size()) {
+            std::cerr << "Corrupt posting list for term " << term_id << ", dropping it" << std::endl;
+            return;
+        }
+        long long last_doc = get_fixed<int64_t>(data.data() + HEADER_BYTES + static_cast<size_t>(block_count - 1) * SKIP_BYTES);
+
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, "INSERT INTO posting_segments (term_id, generation, last_doc, impacts, data) VALUES (?, 1, ?, ?, ?);", -1, &stmt, nullptr);
+        sqlite3_bind_int64(stmt, 1, term_id);
+        sqlite3_bind_int64(stmt, 2, last_doc);
+        sqlite3_bind_int(stmt, 3, impacts ? 1 : 0);
+        sqlite3_bind_blob(stmt, 4, data.data(), static_cast<int>(data.size()), SQLITE_TRANSIENT);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+            std::cerr << "Failed to write postings: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_finalize(stmt);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ store the forward list of one document ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto PostingStore::write_document_terms(sqlite3* db, long long doc_id, std::vector<long long> term_ids) -> void {
+        std::sort(term_ids.begin(), term_ids.end());
+        std::string data;
+        long long previous = 0;
+        for (long long term_id : term_ids) {
+            put_varint(data, static_cast<uint64_t>(term_id - previous));
+            previous = term_id;
+        }
+
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO document_terms (document_id, term_ids) VALUES (?, ?);", -1, &stmt, nullptr);
+        sqlite3_bind_int64(stmt, 1, doc_id);
+        sqlite3_bind_blob(stmt, 2, data.data(), static_cast<int>(data.size()), SQLITE_TRANSIENT);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+            std::cerr << "Failed to write document terms: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_finalize(stmt);
+    }
+
+    PostingStore::~PostingStore() {
+        discard_runs();
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ buffer one document's postings ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto PostingStore::add(sqlite3* db, long long doc_id, uint32_t length, const std::vector<std::pair<long long, uint32_t>>& term_frequencies) -> void {
+        std::vector<long long> term_ids;
+        term_ids.reserve(term_frequencies.size());
+        for (const auto& [term_id, frequency] : term_frequencies) {
+            buffer.push_back({term_id, doc_id, frequency, length});
+            term_ids.push_back(term_id);
+        }
+        batch_documents.insert(doc_id);
+        write_document_terms(db, doc_id, std::move(term_ids));
+        spill_if_full();
+    }
+
+    auto PostingStore::spill_if_full() -> void {
+        size_t budget = static_cast<size_t>(index_stream::Config::get().build_memory_mb) << 20;
+        if (buffer.size() * sizeof(BuildPosting) >= budget)
+            spill();
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ sort the buffer and write it out as a run ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto PostingStore::spill() -> void {
+        const auto& config = index_stream::Config::get();
+        std::filesystem::path directory = config.build_temp_dir.empty() ? std::filesystem::path(config.db_path).parent_path()
+                                                                          : std::filesystem::path(config.build_temp_dir);
+        std::string path = (directory / ("postings." + std::to_string(runs.size()) + ".run")).string();
+
+        std::sort(buffer.begin(), buffer.end());
+        if (!write_run(path, buffer)) {
+            // Keep going in memory rather than lose postings
+            std::filesystem::remove(path);
+            return;
+        }
+        runs.push_back(path);
+        buffer.clear();
+        buffer.shrink_to_fit();
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ forget a document's postings, stored, spilled or still buffered ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto PostingStore::remove(sqlite3* db, long long doc_id) -> std::vector<long long> {
+        std::vector<long long> term_ids;
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, "SELECT term_ids FROM document_terms WHERE document_id = ?;", -1, &stmt, nullptr);
+        sqlite3_bind_int64(stmt, 1, doc_id);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            std::string_view data(static_cast<const char*>(sqlite3_column_blob(stmt, 0)), sqlite3_column_bytes(stmt, 0));
+            size_t position = 0;
+            uint64_t delta;
+            long long term_id = 0;
+            while (position < data.size() && get_varint(data, position, delta)) {
+                term_id += static_cast<long long>(delta);
+                term_ids.push_back(term_id);
+            }
+        }
+        sqlite3_finalize(stmt);
+
+        sqlite3_prepare_v2(db, "DELETE FROM document_terms WHERE document_id = ?;", -1, &stmt, nullptr);
+        sqlite3_bind_int64(stmt, 1, doc_id);
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+
+        // The document may have been indexed earlier in this very batch. Its buffered postings
+        // go now; those already spilled are skipped by the merge, which drops the document's
+        // postings (not its markers) from every run written before this point. Otherwise its
+        // terms are those of the stored lists, which get a removal marker in their next generation
+        if (batch_documents.erase(doc_id)) {
+            std::erase_if(buffer, [doc_id](const BuildPosting& posting) { return posting.doc_id == doc_id && posting.frequency != 0; });
+        } else {
+            for (long long term_id : term_ids)
+                buffer.push_back({term_id, doc_id, 0, 0});
+        }
+        removed_documents[doc_id] = runs.size();
+        spill_if_full();
+        return term_ids;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ open the generation a flush appends to a list ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    // Sets generations to how many the list has already
+    static auto open_generation(sqlite3* db, long long term_id, long long& generations) -> SegmentWriter {
+        long long newest = 0;
+        bool impacts = index_stream::Config::get().impact_index;
+        generations = 0;
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, R"(
+            SELECT generation, impacts, (SELECT COUNT(DISTINCT generation) FROM posting_segments WHERE term_id = ?1)
+            FROM posting_segments WHERE term_id = ?1 ORDER BY generation DESC LIMIT 1;
+        )", -1, &stmt, nullptr);
+        sqlite3_bind_int64(stmt, 1, term_id);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            newest = sqlite3_column_int64(stmt, 0);
+            // A list that has been quantized once has no exact values left to store
+            impacts = impacts || sqlite3_column_int(stmt, 1) != 0;
+            generations = sqlite3_column_int64(stmt, 2);
+        }
+        sqlite3_finalize(stmt);
+        return SegmentWriter(db, term_id, newest + 1, impacts);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ write the rest of the generation, adjust the document count, queue a merge ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    static auto close_generation(sqlite3* db, long long term_id, SegmentWriter& writer, long long document_delta, long long generations) -> void {
+        writer.finish();
+
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, "UPDATE terms SET document_count = MAX(0, document_count + ?) WHERE term_id = ?;", -1, &stmt, nullptr);
+        sqlite3_bind_int64(stmt, 1, document_delta);
+        sqlite3_bind_int64(stmt, 2, term_id);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+            std::cerr << "Failed to update document count: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_finalize(stmt);
+
+        if (generations + 1 > index_stream::Config::get().posting_generations) {
+            sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO posting_merges (term_id) VALUES (?);", -1, &stmt, nullptr);
+            sqlite3_bind_int64(stmt, 1, term_id);
+            sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ append a generation to every list the batch touched ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    // Runs inside the caller's transaction. The spilled runs and the sorted buffer are merged
+    // with a heap in (term, document) order, so each term's new postings arrive together and
+    // already sorted.
+    auto PostingStore::flush(sqlite3* db) -> void {
+        if (buffer.empty() && runs.empty())
+            return;
+
+        std::sort(buffer.begin(), buffer.end());
+        std::vector<std::unique_ptr<RunReader>> readers;
+        if (!runs.empty())
+            std::cout << "Merging " << runs.size() << " spilled posting runs..." << std::endl;
+        for (const auto& path : runs)
+            readers.push_back(std::make_unique<RunReader>(path));
+
+        // Source i < runs.size() is a run, the last source is the buffer
+        const size_t buffer_source = runs.size();
+        size_t buffer_position = 0;
+        using Head = std::pair<BuildPosting, size_t>;
+        auto later = [](const Head& a, const Head& b) { return b.first < a.first || (!(a.first < b.first) && a.second > b.second); };
+        std::priority_queue<Head, std::vector<Head>, decltype(later)> heap(later);
+        for (size_t i = 0; i < readers.size(); i++)
+            if (readers[i]->valid())
+                heap.push({readers[i]->head(), i});
+        if (!buffer.empty())
+            heap.push({buffer[0], buffer_source});
+
+        // Each term's markers and new postings arrive together in doc order and go straight
+        // into its new generation. Every marker was a posting of the stored list and every new
+        // posting was not, which gives the change in the term's document count
+        std::optional<SegmentWriter> writer;
+        long long current_term = 0, generations = 0, document_delta = 0;
+        BuildPosting pending {};
+        bool has_pending = false;
+        while (!heap.empty()) {
+            auto [posting, source] = heap.top();
+            heap.pop();
+            if (source == buffer_source) {
+                if (++buffer_position < buffer.size())
+                    heap.push({buffer[buffer_position], source});
+            } else {
+                readers[source]->advance();
+                if (readers[source]->valid())
+                    heap.push({readers[source]->head(), source});
+            }
+
+            // Spilled before its document was removed: stale, unless it is a removal marker
+            if (source != buffer_source && posting.frequency != 0) {
+                auto removed = removed_documents.find(posting.doc_id);
+                if (removed != removed_documents.end() && source < removed->second)
+                    continue;
+            }
+
+            if (!writer || posting.term_id != current_term) {
+                if (writer) {
+                    if (has_pending)
+                        writer->add({pending.doc_id, pending.frequency, pending.length});
+                    close_generation(db, current_term, *writer, document_delta, generations);
+                }
+                current_term = posting.term_id;
+                writer.emplace(open_generation(db, current_term, generations));
+                document_delta = 0;
+                has_pending = false;
+            }
+            document_delta += posting.frequency == 0 ? -1 : 1;
+
+            // A document that lost its stored posting and got a new one only needs the new one
+            if (has_pending && pending.doc_id == posting.doc_id) {
+                if (pending.frequency == 0)
+                    pending = posting;
+                continue;
+            }
+            if (has_pending)
+                writer->add({pending.doc_id, pending.frequency, pending.length});
+            pending = posting;
+            has_pending = true;
+        }
+        if (writer) {
+            if (has_pending)
+                writer->add({pending.doc_id, pending.frequency, pending.length});
+            close_generation(db, current_term, *writer, document_delta, generations);
+        }
+
+        readers.clear();
+        discard_runs();
+        buffer.clear();
+        buffer.shrink_to_fit();
+        batch_documents.clear();
+        removed_documents.clear();
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ merge the generations of every queued list ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    // Runs inside the caller's transaction
+    auto PostingStore::merge(sqlite3* db) -> void {
+        std::vector<long long> term_ids;
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, "SELECT term_id FROM posting_merges;", -1, &stmt, nullptr);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+            term_ids.push_back(sqlite3_column_int64(stmt, 0));
+        sqlite3_finalize(stmt);
+        if (term_ids.empty())
+            return;
+
+        std::cout << "Merging generations of " << term_ids.size() << " posting lists...\n";
+        for (long long term_id : term_ids)
+            merge_list(db, term_id);
+        sqlite3_exec(db, "DELETE FROM posting_merges;", nullptr, nullptr, nullptr);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ fold a list's newest generations into one ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    // The newest generations are merged, and older ones with them as long as each is at most
+    // twice the size of what is being merged, so the big old generations are rewritten only
+    // once the tail has grown comparable to them: a posting is rewritten a logarithmic number of
+    // times over the life of the list. Removal markers are kept unless the merge reaches the
+    // oldest generation, which is where the postings of removed documents are finally reclaimed.
+    auto PostingStore::merge_list(sqlite3* db, long long term_id) -> void {
+        const auto& config = index_stream::Config::get();
+        std::vector<long long> numbers, sizes;
+        long long last_segment = 0;
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, R"(
+            SELECT generation, SUM(LENGTH(data)), MAX(segment_id) FROM posting_segments
+            WHERE term_id = ? GROUP BY generation ORDER BY generation;
+        )", -1, &stmt, nullptr);
+        sqlite3_bind_int64(stmt, 1, term_id);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            numbers.push_back(sqlite3_column_int64(stmt, 0));
+            sizes.push_back(sqlite3_column_int64(stmt, 1));
+            last_segment = std::max(last_segment, sqlite3_column_int64(stmt, 2));
+        }
+        sqlite3_finalize(stmt);
+
+        size_t count = numbers.size();
+        if (count < 2)
+            return;
+        size_t first = count - std::min(count, std::max<size_t>(2, count + 1 - static_cast<size_t>(config.posting_generations)));
+        long long merged_size = 0;
+        for (size_t i = first; i < count; i++)
+            merged_size += sizes[i];
+        while (first > 0 && sizes[first - 1] <= 2 * merged_size)
+            merged_size += sizes[--first];
+        bool full = first == 0;
+
+        long long live = 0;
+        {
+            PostingCursor cursor;
+            if (!cursor.open(db, term_id, numbers[first]))
+                return;
+            // The merged generation takes the newest number, so it stays on top of the older ones
+            SegmentWriter writer(db, term_id, numbers.back(), config.impact_index || cursor.impacts());
+            Posting posting;
+            while (cursor.next(posting, !full))
+                writer.add(posting);
+            writer.finish();
+            live = writer.live();
+        }
+
+        // Rows written above have higher ids than any merged one
+        sqlite3_prepare_v2(db, "DELETE FROM posting_segments WHERE term_id = ? AND generation >= ? AND segment_id <= ?;", -1, &stmt, nullptr);
+        sqlite3_bind_int64(stmt, 1, term_id);
+        sqlite3_bind_int64(stmt, 2, numbers[first]);
+        sqlite3_bind_int64(stmt, 3, last_segment);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+            std::cerr << "Failed to merge postings: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_finalize(stmt);
+
+        // A merge of the whole list recounts its document frequency from scratch
+        if (full) {
+            sqlite3_prepare_v2(db, "UPDATE terms SET document_count = ? WHERE term_id = ?;", -1, &stmt, nullptr);
+            sqlite3_bind_int64(stmt, 1, live);
+            sqlite3_bind_int64(stmt, 2, term_id);
+            sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ delete the run files of the finished batch ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto PostingStore::discard_runs() -> void {
+        for (const auto& path : runs) {
+            std::error_code error;
+            std::filesystem::remove(path, error);
+        }
+        runs.clear();
+    }
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <sqlite3.h>
+
+#include "spill_run.hpp"
+
+namespace indexer {
+
+    // One document in a term's posting list. The document length travels with the posting so
+    // tf can be computed without looking the document up.
+    struct Posting {
+        long long doc_id;
+        uint32_t frequency;
+        uint32_t length;  // total terms in the document
+        uint8_t impact {};  // quantized tf, only in lists stored as impacts (frequency and length are 0 there)
+
+        // Written by a later generation of the list for a document it no longer holds
+        bool removed() const { return frequency == 0 && impact == 0; }
+    };
+
+    // Postings per block; the skip table has one entry per block
+    constexpr size_t POSTING_BLOCK_SIZE = 128;
+
+    // Blocks per segment row, so a writer never holds more than this many blocks
+    constexpr size_t POSTING_SEGMENT_BLOCKS = 32;
+
+    // Set in the block count of a list stored as impacts
+    constexpr uint32_t IMPACT_LIST = 0x80000000u;
+
+    // 8-bit impact of a posting: its tf (frequency / length) on a log scale of 16 octaves, 255
+    // for tf = 1 down to 1 for 2^-16 or less. Steps are about 4.4% apart, so the relative error
+    // is at most half that, and the scale is the same for every list, so stored impacts stay
+    // valid however often a list is rewritten.
+    uint8_t quantize_impact(uint32_t frequency, uint32_t length);
+    double impact_tf(uint8_t impact);
+
+    // A term's list is a stack of generations in posting_segments, each flush appending one on
+    // top. A generation is one or more segment rows covering ascending, disjoint doc-id ranges,
+    // and each segment BLOB is laid out in host byte order as:
+    //   [u32 doc count][u32 block count, | IMPACT_LIST for impacts]
+    //   block count x [i64 last doc id][u32 byte offset][u32 postings]   skip table
+    //   blocks of varint (doc id delta, frequency, length) triples, or of (varint doc id
+    //   delta, u8 impact) pairs
+    // Deltas run across block boundaries, a block's first delta is taken from the previous
+    // block's last doc id, so any block can be decoded on its own with the skip table at hand.
+    // Where generations disagree on a document the newest one wins; a removed() posting (zero
+    // frequency and length, or impact 0) drops the document from the older ones.
+
+    // Reads one posting list through incremental BLOB I/O: each generation's skip table first,
+    // then only the blocks that are actually visited, so a doc-id range touches a slice of a
+    // long list. The generations are merged by doc id as they are read.
+    class PostingCursor {
+    public:
+        // Binds the term id and the oldest generation to read
+        static constexpr const char* SEGMENTS_QUERY =
+            "SELECT segment_id, generation, last_doc FROM posting_segments WHERE term_id = ? AND generation >= ? ORDER BY generation, last_doc;";
+
+        PostingCursor() = default;
+        ~PostingCursor();
+        PostingCursor(const PostingCursor&) = delete;
+        PostingCursor& operator=(const PostingCursor&) = delete;
+
+        // false if the term has no stored postings. segments is SEGMENTS_QUERY prepared on db,
+        // or null to prepare it here. The segments are listed first and opened later, so a
+        // reader beside a live writer holds a transaction around the cursor's whole use.
+        bool open(sqlite3* db, long long term_id, long long from_generation = 0, sqlite3_stmt* segments = nullptr);
+        bool impacts() const;  // some generation is stored as impacts
+
+        // Moves to the first block that may hold doc_id or a later document
+        void seek(long long doc_id);
+        // keep_removed hands out removal markers as well, for a merge that leaves older
+        // generations behind
+        bool next(Posting& posting, bool keep_removed = false);
+        // Up to capacity live postings in doc order, 0 at the end of the list
+        size_t read(Posting* postings, size_t capacity);
+
+    private:
+        struct SkipEntry {
+            int64_t last_doc;
+            uint32_t offset;
+            uint32_t count;
+        };
+
+        struct Generation {
+            std::vector<std::pair<long long, long long>> segments;  // (segment id, last doc id), in doc order
+            size_t segment {};
+            sqlite3_blob* blob {};
+            bool impact_list {};
+            std::vector<SkipEntry> skips;
+            size_t data_start {};
+            size_t next_block {};
+            std::string block;
+            size_t position {};
+            uint32_t left {};
+            long long previous {};
+            Posting head {};
+            bool has_head {};
+            bool exhausted {};
+        };
+
+        sqlite3* db {};
+        std::vector<Generation> generations;  // oldest first
+
+        bool open_segment(Generation& generation, size_t index);
+        bool load_block(Generation& generation, size_t index);
+        bool advance(Generation& generation);
+    };
+
+    // Builds one generation of a term's list from postings in doc-id order, writing a segment
+    // row whenever POSTING_SEGMENT_BLOCKS blocks are full
+    class SegmentWriter {
+    public:
+        SegmentWriter(sqlite3* db, long long term_id, long long generation, bool impacts);
+
+        void add(const Posting& posting);
+        void finish();  // writes what is left; nothing at all for an empty generation
+        long long live() const { return live_postings; }  // postings added that are not removal markers
+
+    private:
+        sqlite3* db;
+        long long term_id;
+        long long generation;
+        bool impacts;
+        std::string skips;
+        std::string blocks;
+        uint32_t count {};
+        uint32_t in_block {};
+        uint32_t block_start {};
+        long long previous {};
+        long long live_postings {};
+
+        void close_block();
+        void write_segment();
+    };
+
+    // Writer side of the posting lists. Postings of indexed documents, and removal markers for
+    // the stored postings of removed ones, are buffered as (term, document) tuples; once the
+    // buffer outgrows INDEXSTREAM_BUILD_MEMORY_MB it is sorted and spilled to a run file. On
+    // flush, before the batch commits, the runs and the buffer are merged in term order and
+    // streamed into one new generation per affected list, so a flush costs what the batch adds
+    // and removes, not the length of the lists it touches, and memory stays bounded by the
+    // budget plus one read buffer per run and one segment being written. Lists that pile up
+    // more than INDEXSTREAM_POSTING_GENERATIONS generations are merged by compaction, which
+    // streams them block by block the same way. document_terms is the forward list that tells
+    // which lists a document appears in.
+    class PostingStore {
+    public:
+        PostingStore() = default;
+        ~PostingStore();
+        PostingStore(const PostingStore&) = delete;
+        PostingStore& operator=(const PostingStore&) = delete;
+
+        static void create_tables(sqlite3* db);
+        // Replaces every generation of the list, stored as impacts with INDEXSTREAM_IMPACT_INDEX
+        // or when the postings already are
+        static void write_list(sqlite3* db, long long term_id, const std::vector<Posting>& postings);
+        // Stores a list BLOB of the single-row postings table as the list's first generation
+        static void import_list(sqlite3* db, long long term_id, std::string_view data);
+        static void write_document_terms(sqlite3* db, long long doc_id, std::vector<long long> term_ids);
+
+        // Called under the indexer's ingest lock
+        void add(sqlite3* db, long long doc_id, uint32_t length, const std::vector<std::pair<long long, uint32_t>>& term_frequencies);
+        std::vector<long long> remove(sqlite3* db, long long doc_id);  // returns the terms the document was in
+        void flush(sqlite3* db);
+        void merge(sqlite3* db);  // merges the generations of lists flush queued for it
+
+    private:
+        std::vector<BuildPosting> buffer;  // new postings not yet spilled
+        std::vector<std::string> runs;  // spilled run files, oldest first
+        std::unordered_set<long long> batch_documents;  // documents with postings in the buffer or a run
+        std::unordered_map<long long, size_t> removed_documents;  // doc id -> runs spilled when it was removed
+
+        void spill_if_full();
+        void spill();
+        void merge_list(sqlite3* db, long long term_id);
+        void discard_runs();
+    };
+}
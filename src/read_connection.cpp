@@ -0,0 +1,61 @@
+#include <iostream>
+
+#include "read_connection.hpp"
+
+namespace indexer {
+
+    ReadConnection::~ReadConnection() {
+        close();
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ finalize cached statements and drop the connection ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto ReadConnection::close() -> void {
+        for (auto& [sql, stmt] : statements)
+            sqlite3_finalize(stmt);
+        statements.clear();
+
+        if (db) {
+            sqlite3_close(db);
+            db = nullptr;
+        }
+        opened_generation = -1;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ (re)open the store read-only for the calling thread ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto ReadConnection::open(const std::string& path, long long generation) -> bool {
+        close();
+        if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+            std::cerr << "Cannot open read connection: " << sqlite3_errmsg(db) << std::endl;
+            sqlite3_close(db);
+            db = nullptr;
+            return false;
+        }
+
+        // WAL readers only wait on the writer during a checkpoint or recovery
+        sqlite3_busy_timeout(db, 5000);
+        opened_generation = generation;
+        return true;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ cached prepared statement, keyed by its SQL text ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    // The SQL must outlive the connection, callers pass string literals.
+    auto ReadConnection::statement(std::string_view sql) -> sqlite3_stmt* {
+        if (!db)
+            return nullptr;
+
+        auto it = statements.find(sql);
+        if (it != statements.end()) {
+            sqlite3_reset(it->second);
+            sqlite3_clear_bindings(it->second);
+            return it->second;
+        }
+
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v3(db, sql.data(), static_cast<int>(sql.size()), SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+            std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db) << std::endl;
+            return nullptr;
+        }
+        statements.emplace(sql, stmt);
+        return stmt;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <sqlite3.h>
+
+namespace indexer {
+
+    // Read-only SQLite connection owned by a single searching thread. Opened with NOMUTEX since
+    // it is never shared, and it keeps its prepared statements across queries. The generation
+    // tells the owner when the store file was swapped underneath it and it has to reopen.
+    class ReadConnection {
+    public:
+        ReadConnection() = default;
+        ~ReadConnection();
+        ReadConnection(const ReadConnection&) = delete;
+        ReadConnection& operator=(const ReadConnection&) = delete;
+
+        bool open(const std::string& path, long long generation);
+        long long generation() const { return opened_generation; }
+        sqlite3* handle() const { return db; }
+
+        // Prepared once per connection, returned reset with bindings cleared
+        sqlite3_stmt* statement(std::string_view sql);
+
+    private:
+        sqlite3* db {};
+        long long opened_generation {-1};
+        std::unordered_map<std::string_view, sqlite3_stmt*> statements;
+
+        void close();
+    };
+}
@@ -0,0 +1,123 @@
+#include <cmath>
+#include <limits>
+
+#include "score_accumulator.hpp"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define INDEXSTREAM_X86 1
+#endif
+
+namespace indexer {
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ scalar kernel, also used for the tail of the SIMD kernels ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    static size_t nonzero_scalar(const int32_t* values, size_t count, uint32_t* offsets) {
+        size_t found = 0;
+        for (size_t i = 0; i < count; i++)
+            if (values[i] != 0)
+                offsets[found++] = static_cast<uint32_t>(i);
+        return found;
+    }
+
+    // Appends the lanes set in mask, i + lane for each
+    static inline size_t push_lanes(unsigned mask, size_t i, uint32_t* offsets, size_t found) {
+        while (mask) {
+            offsets[found++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+        return found;
+    }
+
+    static size_t finish_tail(const int32_t* values, size_t count, size_t i, uint32_t* offsets, size_t found) {
+        size_t tail = nonzero_scalar(values + i, count - i, offsets + found);
+        for (size_t j = found; j < found + tail; j++)
+            offsets[j] += static_cast<uint32_t>(i);
+        return found + tail;
+    }
+
+#ifdef INDEXSTREAM_X86
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ SSE2 kernel, 4 scores per step ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    static size_t nonzero_sse2(const int32_t* values, size_t count, uint32_t* offsets) {
+        const __m128i zero = _mm_setzero_si128();
+        size_t found = 0, i = 0;
+
+        for (; i + 4 <= count; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+            unsigned mask = ~static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, zero)))) & 0xfu;
+            found = push_lanes(mask, i, offsets, found);
+        }
+        return finish_tail(values, count, i, offsets, found);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ AVX2 kernel, 8 scores per step ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    __attribute__((target("avx2")))
+    static size_t nonzero_avx2(const int32_t* values, size_t count, uint32_t* offsets) {
+        const __m256i zero = _mm256_setzero_si256();
+        size_t found = 0, i = 0;
+
+        for (; i + 8 <= count; i += 8) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+            unsigned mask = ~static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, zero)))) & 0xffu;
+            found = push_lanes(mask, i, offsets, found);
+        }
+        return finish_tail(values, count, i, offsets, found);
+    }
+#endif
+
+    using nonzero_kernel = size_t (*)(const int32_t*, size_t, uint32_t*);
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ pick the widest kernel the CPU supports, once ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    static nonzero_kernel select_kernel() {
+#ifdef INDEXSTREAM_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return nonzero_avx2;
+        return nonzero_sse2;
+#else
+        return nonzero_scalar;
+#endif
+    }
+
+    auto nonzero_offsets(const int32_t* values, size_t count, uint32_t* offsets) -> size_t {
+        static const nonzero_kernel kernel = select_kernel();
+        return kernel(values, count, offsets);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ size the arrays for a shard's range; they are already zero ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto ScoreAccumulator::begin(long long first_doc, long long last_doc, double max_weight, size_t terms) -> void {
+        first = first_doc;
+        span = last_doc >= first_doc ? static_cast<size_t>(last_doc - first_doc + 1) : 0;
+        pages = (span + PAGE_DOCS - 1) / PAGE_DOCS;
+        if (fixed.size() < span)
+            fixed.resize(span, 0);
+        if (touched.size() < pages)
+            touched.resize(pages, 0);
+        if (exact_used && exact.size() < span)
+            exact.resize(span, 0.0);
+
+        this->max_weight = max_weight;
+        scale = std::floor(static_cast<double>(std::numeric_limits<int32_t>::max()) / static_cast<double>(std::max<size_t>(terms, 1)));
+        unit = max_weight > 0.0 ? max_weight / scale : 0.0;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ a term's contribution per impact level, in fixed point ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    // A weighted term never rounds to nothing, so its documents are still found
+    auto ScoreAccumulator::impact_table(double weight) const -> ImpactTable {
+        ImpactTable table {};
+        if (max_weight <= 0.0 || weight == 0.0)
+            return table;
+        double scaled = weight / max_weight * scale;
+        for (int impact = 1; impact < 256; impact++) {
+            long long value = std::llround(impact_tf(static_cast<uint8_t>(impact)) * scaled);
+            table[impact] = static_cast<int32_t>(value != 0 ? value : weight > 0.0 ? 1 : -1);
+        }
+        return table;
+    }
+
+    auto ScoreAccumulator::add_exact(size_t offset, double score) -> void {
+        if (exact.size() < span)
+            exact.resize(span, 0.0);
+        exact_used = true;
+        exact[offset] += score;
+    }
+}
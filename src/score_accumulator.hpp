@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "posting_list.hpp"
+
+namespace indexer {
+
+    // Offsets of the nonzero entries of values, written to offsets (room for count entries);
+    // returns how many there are. Uses the widest SIMD kernel the CPU supports.
+    size_t nonzero_offsets(const int32_t* values, size_t count, uint32_t* offsets);
+
+    // Scores of one search shard, dense over its doc-id range: one int32 per document, indexed
+    // by doc_id - first_doc. An impact posting adds its term's ImpactTable entry, the impact's
+    // tf times the term's weight in fixed point, so a block of postings costs a table lookup
+    // and an add each, with no hashing. Exact postings add to a parallel array of doubles that
+    // is only allocated once a list without impacts shows up. Touched pages of PAGE_DOCS
+    // documents are flagged, so draining the scores and clearing them for the next query costs
+    // the pages the query hit rather than the whole range.
+    class ScoreAccumulator {
+    public:
+        using ImpactTable = std::array<int32_t, 256>;
+        static constexpr size_t PAGE_DOCS = 64;
+
+        // Every term's table stays below INT32_MAX / terms in magnitude, so the sum over all
+        // the terms of a query cannot overflow
+        void begin(long long first_doc, long long last_doc, double max_weight, size_t terms);
+        ImpactTable impact_table(double weight) const;
+
+        // Postings in doc order, all within the range
+        void add(const Posting* postings, size_t count, const ImpactTable& table, double weight) {
+            for (size_t i = 0; i < count; i++) {
+                size_t offset = static_cast<size_t>(postings[i].doc_id - first);
+                touched[offset / PAGE_DOCS] = 1;
+                fixed[offset] += table[postings[i].impact];  // entry 0 is 0 for exact postings
+                if (postings[i].impact == 0 && postings[i].length != 0)
+                    add_exact(offset, static_cast<double>(postings[i].frequency) / postings[i].length * weight);
+            }
+        }
+
+        // Calls visit(doc_id, score) for every document with a nonzero score and leaves the
+        // accumulator zeroed for the next query
+        template<typename F>
+        void drain(F&& visit) {
+            uint32_t offsets[PAGE_DOCS];
+            for (size_t page = 0; page < pages; page++) {
+                if (!touched[page])
+                    continue;
+                touched[page] = 0;
+                size_t begin = page * PAGE_DOCS;
+                size_t end = std::min(span, begin + PAGE_DOCS);
+                if (exact_used) {
+                    for (size_t offset = begin; offset < end; offset++)
+                        if (fixed[offset] != 0 || exact[offset] != 0.0)
+                            visit(first + static_cast<long long>(offset), fixed[offset] * unit + exact[offset]);
+                    std::fill(exact.begin() + begin, exact.begin() + end, 0.0);
+                } else {
+                    size_t found = nonzero_offsets(fixed.data() + begin, end - begin, offsets);
+                    for (size_t i = 0; i < found; i++)
+                        visit(first + static_cast<long long>(begin + offsets[i]), fixed[begin + offsets[i]] * unit);
+                }
+                std::fill(fixed.begin() + begin, fixed.begin() + end, 0);
+            }
+            exact_used = false;
+        }
+
+    private:
+        std::vector<int32_t> fixed;
+        std::vector<double> exact;
+        std::vector<uint8_t> touched;
+        long long first {};
+        size_t span {};
+        size_t pages {};
+        double scale {};
+        double unit {};  // score of one fixed-point step
+        double max_weight {};
+        bool exact_used {};
+
+        void add_exact(size_t offset, double score);
+    };
+}
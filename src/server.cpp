@@ -2,35 +2,62 @@
 
 namespace index_stream {
 
-    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ create socket and bind to port ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
-    HTTP_Server::HTTP_Server(int port) : port(port) {
-        if((this->server_socket = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-            std::cerr << "Error: Failed to create socket!\n";
-            exit(1);
-        }
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ lane shares of the connection pool ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // Bulk requests are capped at bulk_lane_threads workers, so searches always have the rest
+    static std::array<LaneConfig, LANE_COUNT> request_lanes() {
+        const auto& config = Config::get();
+        std::array<LaneConfig, LANE_COUNT> lanes {};
+        lanes[static_cast<size_t>(Lane::interactive)] = {static_cast<unsigned>(config.interactive_lane_weight), SIZE_MAX};
+        lanes[static_cast<size_t>(Lane::bulk)] = {static_cast<unsigned>(config.bulk_lane_weight), static_cast<size_t>(config.bulk_lane_threads)};
+        return lanes;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ create sockets and bind to port ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // With several listeners every one binds its own socket to the port with SO_REUSEPORT, and the
+    // kernel spreads incoming connections over them, so no single accept() call is a bottleneck
+    HTTP_Server::HTTP_Server(int port)
+        : port(port), thread_pool(Config::get().server_threads, request_lanes(), Config::get().pin_threads) {
+        const int listeners = Config::get().listeners;
 
         this->server_address.sin_addr.s_addr = INADDR_ANY;
         this->server_address.sin_family = AF_INET;
         this->server_address.sin_port = htons(this->port);
 
-        if (bind(server_socket, (sockaddr*)&server_address, sizeof(server_address)) == -1) {
-            std::cerr << "Error: Failed to bind socket to port!\n";
-            exit(1);
+        for (int i = 0; i < listeners; i++) {
+            int server_socket = socket(AF_INET, SOCK_STREAM, 0);
+            if (server_socket < 0) {
+                std::cerr << "Error: Failed to create socket!\n";
+                exit(1);
+            }
+            this->server_sockets.push_back(server_socket);
+
+            int reuse = 1;
+            if (listeners > 1 && setsockopt(server_socket, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0) {
+                std::cerr << "Error: Failed to set SO_REUSEPORT: " << std::strerror(errno) << "\n";
+                exit(1);
+            }
+
+            if (bind(server_socket, (sockaddr*)&server_address, sizeof(server_address)) == -1) {
+                std::cerr << "Error: Failed to bind socket to port!\n";
+                exit(1);
+            }
         }
     }
 
-    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ close socket on deletion ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ close sockets on deletion ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
     HTTP_Server::~HTTP_Server() {
-        close(this->server_socket);
+        for (int server_socket : this->server_sockets)
+            close(server_socket);
     }
 
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ check if new webpages scraped and update db ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
     auto HTTP_Server::recurring_db_update() -> void {
+        Tracer::get_instance().name_thread("db-update");
         for(;;) {
             int file_count {};
             auto& idxr = indexer::Indexer::get_instance();
 
-            for (const auto& entry : std::filesystem::directory_iterator("../raw_dump")) {
+            for (const auto& entry : std::filesystem::directory_iterator(Config::get().dump_dir)) {
                 if (std::filesystem::is_regular_file(entry.status())) 
                     file_count++;
 
@@ -38,10 +65,16 @@ namespace index_stream {
                     idxr.update_db();
                     thread_pool.pause_task_queue();
 
-                    if (thread_pool.await_pending_tasks())
+                    bool drained;
+                    {
+                        TraceSpan trace("await_pending_tasks");
+                        drained = thread_pool.await_pending_tasks();
+                    }
+                    if (drained)
                         idxr.merge_db();
-                        
+
                     thread_pool.resume_task_queue();
+                    Tracer::get_instance().export_trace();
                     break;
                 }
             }
@@ -51,30 +84,84 @@ namespace index_stream {
 
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ start listening for connections and handle client when connected ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
     auto HTTP_Server::start() -> void {
-        if(listen(server_socket, 10) < 0) {
-            std::cerr << "Error: Failed to listen for connections!\n";
-            exit(1);
+        AdmissionControl::get_instance().watch(thread_pool);
+        for (int server_socket : this->server_sockets) {
+            if(listen(server_socket, Config::get().listen_backlog) < 0) {
+                std::cerr << "Error: Failed to listen for connections!\n";
+                exit(1);
+            }
         }
 
-        std::cout << "Server Started! Listening on port: " << this->port << std::endl;
-        std::thread t(&HTTP_Server::recurring_db_update, this);
-        auto& idxr = indexer::Indexer::get_instance();
+        std::cout << "Server Started! Listening on port: " << this->port;
+        if (this->server_sockets.size() > 1)
+            std::cout << " (" << this->server_sockets.size() << " listeners)";
+        std::cout << std::endl;
+
+        // A coordinator owns no index, it only fans queries out to the shard servers
+        std::thread t;
+        if (Config::get().role == "coordinator") {
+            Coordinator::get_instance();
+        } else {
+            // New dump files are indexed continuously; the hourly rebuild is the fallback
+            if (Config::get().ingest != "inotify" || !IngestWatcher::get_instance().start())
+                t = std::thread(&HTTP_Server::recurring_db_update, this);
+            indexer::Indexer::get_instance();
+        }
+
+        // The calling thread serves the first socket
+        std::vector<std::thread> listeners;
+        for (size_t i = 1; i < this->server_sockets.size(); i++)
+            listeners.emplace_back(&HTTP_Server::accept_loop, this, this->server_sockets[i], i);
+        accept_loop(this->server_sockets[0], 0);
+
+        for (auto& listener : listeners)
+            listener.join();
+        if (t.joinable())
+            t.join();
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ accept connections on one socket and queue them for the workers ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto HTTP_Server::accept_loop(int server_socket, size_t listener) -> void {
+        if (Config::get().pin_threads)
+            pin_to_core(listener);
 
         for(;;) {
 
-            int client_socket = accept(this->server_socket, nullptr, nullptr);
+            int client_socket = accept(server_socket, nullptr, nullptr);
 
             if(client_socket < 0) {
                 std::cerr << "Error: Failed to accept connection!\n";
                 continue;
             }
 
-            this->thread_pool.enqueue([client_socket] {
-                handle_client(client_socket);
+            // Past the connection cap, refuse here rather than queue work nobody will wait for
+            auto& admission = AdmissionControl::get_instance();
+            if (!admission.try_acquire()) {
+                reject_client(client_socket, admission.retry_after());
+                continue;
+            }
+
+            // Every connection starts on the interactive lane. Bulk requests come back after their
+            // headers and are requeued on the bulk lane to read their body and run there
+            admission.enqueued();
+            auto accepted = AdmissionControl::clock::now();
+            this->thread_pool.enqueue([this, client_socket, accepted, &admission] {
+                if (admission.dequeued(AdmissionControl::clock::now() - accepted)) {
+                    reject_client(client_socket, admission.retry_after());
+                    admission.release();
+                    return;
+                }
+
+                auto deferred = handle_client(client_socket, true);
+                if (!deferred) {
+                    admission.release();
+                    return;
+                }
+                this->thread_pool.enqueue_to(Lane::bulk, [client_socket, received = std::move(*deferred), &admission] {
+                    handle_client(client_socket, false, received);
+                    admission.release();
+                });
             });
         }
-
-        if (t.joinable())
-            t.join();
     }
 }
\ No newline at end of file
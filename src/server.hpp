@@ -4,12 +4,19 @@
 #include <netinet/in.h>
 #include <unistd.h>
 #include <string>
+#include <vector>
 #include <cstring>
+#include <cerrno>
 #include <fcntl.h>
 #include <sys/select.h>
 
 #include "threadpool.hpp"
 #include "http_parser.hpp"
+#include "ingest_watcher.hpp"
+#include "config.hpp"
+#include "coordinator.hpp"
+#include "admission.hpp"
+#include "trace.hpp"
 
 #ifndef RFSS_SERVER_HPP
 #define RFSS_SERVER_HPP
@@ -17,11 +24,12 @@
 namespace index_stream {
     class HTTP_Server {
     private:
-        int server_socket {};
+        std::vector<int> server_sockets;   // one per accept thread, sharing the port via SO_REUSEPORT
         int port{};
         sockaddr_in server_address {};
-        ThreadPool thread_pool{4};
+        ThreadPool thread_pool;
         void recurring_db_update();
+        void accept_loop(int server_socket, size_t listener);
 
     public:
         HTTP_Server(int port);
@@ -0,0 +1,83 @@
+#include <algorithm>
+
+#include "simhash.hpp"
+
+namespace indexer {
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ FNV-1a over the term bytes, finished with a murmur mix ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto hash_term(std::string_view term) -> uint64_t {
+        uint64_t h = 1469598103934665603ULL;
+        for (unsigned char c : term) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ cut the 64 bits into max_distance + 1 bands ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    SimHashIndex::SimHashIndex(int max_distance) : max_distance(max_distance < 0 ? 0 : (max_distance > 15 ? 15 : max_distance)) {
+        int band_count = this->max_distance + 1;
+        int shift = 0;
+        for (int i = 0; i < band_count; i++) {
+            int width = (64 - shift) / (band_count - i);
+            uint64_t mask = (width >= 64) ? ~0ULL : ((1ULL << width) - 1);
+            bands.push_back({shift, mask});
+            shift += width;
+        }
+        tables.resize(bands.size());
+    }
+
+    auto SimHashIndex::find(uint64_t fingerprint) const -> long long {
+        for (size_t i = 0; i < bands.size(); i++) {
+            uint64_t key = (fingerprint >> bands[i].shift) & bands[i].mask;
+            auto bucket = tables[i].find(key);
+            if (bucket == tables[i].end())
+                continue;
+
+            for (const auto& [candidate, doc_id] : bucket->second)
+                if (__builtin_popcountll(candidate ^ fingerprint) <= max_distance)
+                    return doc_id;
+        }
+        return 0;
+    }
+
+    auto SimHashIndex::insert(uint64_t fingerprint, long long doc_id) -> void {
+        for (size_t i = 0; i < bands.size(); i++) {
+            uint64_t key = (fingerprint >> bands[i].shift) & bands[i].mask;
+            tables[i][key].emplace_back(fingerprint, doc_id);
+        }
+        count++;
+    }
+
+    auto SimHashIndex::erase(uint64_t fingerprint, long long doc_id) -> void {
+        bool found = false;
+        for (size_t i = 0; i < bands.size(); i++) {
+            uint64_t key = (fingerprint >> bands[i].shift) & bands[i].mask;
+            auto bucket = tables[i].find(key);
+            if (bucket == tables[i].end())
+                continue;
+
+            auto& entries = bucket->second;
+            auto it = std::find(entries.begin(), entries.end(), std::make_pair(fingerprint, doc_id));
+            if (it == entries.end())
+                continue;
+            entries.erase(it);
+            if (entries.empty())
+                tables[i].erase(bucket);
+            found = true;
+        }
+        if (found)
+            count--;
+    }
+
+    auto SimHashIndex::clear() -> void {
+        for (auto& table : tables)
+            table.clear();
+        count = 0;
+    }
+}
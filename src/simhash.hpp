@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace indexer {
+
+    // 64-bit FNV-1a with a final avalanche, used as the per-feature hash
+    uint64_t hash_term(std::string_view term);
+
+    // Weighted SimHash over (term, count) pairs: every term votes on each of the 64 bits with
+    // its count, the sign of each tally becomes the fingerprint bit
+    template<typename Counts>
+    uint64_t simhash(const Counts& counts) {
+        long long tally[64] {};
+        for (const auto& [term, count] : counts) {
+            uint64_t h = hash_term(term);
+            for (int bit = 0; bit < 64; bit++)
+                tally[bit] += ((h >> bit) & 1) ? count : -count;
+        }
+
+        uint64_t fingerprint = 0;
+        for (int bit = 0; bit < 64; bit++)
+            if (tally[bit] > 0)
+                fingerprint |= (1ULL << bit);
+        return fingerprint;
+    }
+
+    // Banded lookup table for fingerprints. With max_distance d the fingerprint is cut into d + 1
+    // bands; two fingerprints within d bits of each other agree exactly on at least one band
+    // (pigeonhole), so only documents sharing a band are compared.
+    class SimHashIndex {
+    public:
+        explicit SimHashIndex(int max_distance = 3);
+
+        // Returns the document id of a stored fingerprint within max_distance, or 0 if none
+        long long find(uint64_t fingerprint) const;
+        void insert(uint64_t fingerprint, long long doc_id);
+        // Drops one fingerprint/document pair, for a page whose content changed or that is gone
+        void erase(uint64_t fingerprint, long long doc_id);
+        void clear();
+        size_t size() const { return count; }
+
+    private:
+        struct Band {
+            int shift;
+            uint64_t mask;
+        };
+
+        int max_distance;
+        size_t count {};
+        std::vector<Band> bands;
+        std::vector<std::unordered_map<uint64_t, std::vector<std::pair<uint64_t, long long>>>> tables;
+    };
+}
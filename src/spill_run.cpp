@@ -0,0 +1,106 @@
+#include <iostream>
+
+#include "spill_run.hpp"
+
+namespace indexer {
+
+    // Bytes read from a run file at a time
+    const size_t RUN_BUFFER_BYTES = 256 << 10;
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ sorted postings -> run file ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto write_run(const std::string& path, const std::vector<BuildPosting>& postings) -> bool {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Failed to create run file: " << path << std::endl;
+            return false;
+        }
+
+        std::string chunk;
+        auto put_varint = [&chunk](uint64_t value) {
+            while (value >= 0x80) {
+                chunk.push_back(static_cast<char>(value | 0x80));
+                value >>= 7;
+            }
+            chunk.push_back(static_cast<char>(value));
+        };
+
+        long long term = 0, previous = 0;
+        for (const auto& posting : postings) {
+            if (posting.term_id != term)
+                previous = 0;
+            put_varint(static_cast<uint64_t>(posting.term_id - term));
+            put_varint(static_cast<uint64_t>(posting.doc_id - previous));
+            put_varint(posting.frequency);
+            put_varint(posting.length);
+            term = posting.term_id;
+            previous = posting.doc_id;
+
+            if (chunk.size() >= RUN_BUFFER_BYTES) {
+                out.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+                chunk.clear();
+            }
+        }
+        out.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        out.close();
+        if (!out) {
+            std::cerr << "Failed to write run file: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    RunReader::RunReader(const std::string& path) : in(path, std::ios::binary), buffer(RUN_BUFFER_BYTES) {
+        if (!in)
+            std::cerr << "Failed to open run file: " << path << std::endl;
+        advance();
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ buffered byte and varint reads ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto RunReader::get_byte(uint8_t& byte) -> bool {
+        if (position == filled) {
+            if (!in)
+                return false;
+            in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            filled = static_cast<size_t>(in.gcount());
+            position = 0;
+            if (filled == 0)
+                return false;
+        }
+        byte = static_cast<uint8_t>(buffer[position++]);
+        return true;
+    }
+
+    auto RunReader::get_varint(uint64_t& value) -> bool {
+        value = 0;
+        uint8_t byte;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (!get_byte(byte))
+                return false;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ decode the next posting of the run ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto RunReader::advance() -> void {
+        uint64_t term_delta, doc_delta, frequency, length;
+        if (!get_varint(term_delta)) {
+            has_head = false;
+            return;
+        }
+        if (!get_varint(doc_delta) || !get_varint(frequency) || !get_varint(length)) {
+            std::cerr << "Truncated run file, dropping its tail" << std::endl;
+            has_head = false;
+            return;
+        }
+
+        long long previous = (has_head && term_delta == 0) ? current.doc_id : 0;
+        current.term_id += static_cast<long long>(term_delta);
+        current.doc_id = previous + static_cast<long long>(doc_delta);
+        current.frequency = static_cast<uint32_t>(frequency);
+        current.length = static_cast<uint32_t>(length);
+        has_head = true;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace indexer {
+
+    // One buffered (term, document) posting of an index build. Frequency 0 marks the removal
+    // of the document's stored posting.
+    struct BuildPosting {
+        long long term_id;
+        long long doc_id;
+        uint32_t frequency;
+        uint32_t length;
+    };
+
+    inline bool operator<(const BuildPosting& a, const BuildPosting& b) {
+        return a.term_id != b.term_id ? a.term_id < b.term_id : a.doc_id < b.doc_id;
+    }
+
+    // Writes postings sorted by (term, document) to a temporary run file as varints: term id
+    // delta, then document id delta (from 0 whenever the term changes), frequency and length.
+    // Returns false if the file could not be written completely.
+    bool write_run(const std::string& path, const std::vector<BuildPosting>& postings);
+
+    // Streams one run back in order through a fixed-size read buffer, so merging any number of
+    // runs costs one buffer per run
+    class RunReader {
+    public:
+        explicit RunReader(const std::string& path);
+
+        bool valid() const { return has_head; }
+        const BuildPosting& head() const { return current; }
+        void advance();  // moves head to the next posting, valid() turns false at the end
+
+    private:
+        std::ifstream in;
+        std::vector<char> buffer;
+        size_t position {};
+        size_t filled {};
+        BuildPosting current {};
+        bool has_head = false;
+
+        bool get_byte(uint8_t& byte);
+        bool get_varint(uint64_t& value);
+    };
+}
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <cstring>
+
+#include "term_table.hpp"
+
+namespace indexer {
+
+    // Grow once the table is this full, in eighths
+    const size_t MAX_LOAD_EIGHTHS = 5;
+
+    static size_t round_up_pow2(size_t n) {
+        size_t capacity = 16;
+        while (capacity < n)
+            capacity <<= 1;
+        return capacity;
+    }
+
+    TermTable::TermTable(size_t capacity) : slots(round_up_pow2(capacity)), mask(slots.size() - 1) {
+        items.reserve(slots.size() * MAX_LOAD_EIGHTHS / 8);
+        hashes.reserve(items.capacity());
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ linear probe: tag first, bytes only on a tag match ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto TermTable::probe(std::string_view term, uint64_t hash) const -> size_t {
+        const uint32_t tag = static_cast<uint32_t>(hash >> 32);
+        size_t position = static_cast<size_t>(hash) & mask;
+        while (true) {
+            const Slot& slot = slots[position];
+            if (slot.index == 0)
+                return position;
+            if (slot.tag == tag) {
+                std::string_view stored = items[slot.index - 1].first;
+                if (stored.size() == term.size() && std::memcmp(stored.data(), term.data(), term.size()) == 0)
+                    return position;
+            }
+            position = (position + 1) & mask;
+        }
+    }
+
+    auto TermTable::value(std::string_view term, uint64_t hash, bool& inserted) -> long long& {
+        size_t position = probe(term, hash);
+        if (slots[position].index != 0) {
+            inserted = false;
+            return items[slots[position].index - 1].second;
+        }
+
+        inserted = true;
+        items.emplace_back(term, 0);
+        hashes.push_back(hash);
+        slots[position] = {static_cast<uint32_t>(hash >> 32), static_cast<uint32_t>(items.size())};
+        if (items.size() * 8 > slots.size() * MAX_LOAD_EIGHTHS)
+            grow();
+        return items.back().second;
+    }
+
+    auto TermTable::find(std::string_view term, uint64_t hash) const -> const long long* {
+        size_t position = probe(term, hash);
+        return slots[position].index == 0 ? nullptr : &items[slots[position].index - 1].second;
+    }
+
+    auto TermTable::clear() -> void {
+        if (items.empty())
+            return;
+        std::fill(slots.begin(), slots.end(), Slot{0, 0});
+        items.clear();
+        hashes.clear();
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ double the slot array and re-place every entry ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto TermTable::grow() -> void {
+        slots.assign(slots.size() * 2, Slot{0, 0});
+        mask = slots.size() - 1;
+        for (size_t i = 0; i < items.size(); i++) {
+            size_t position = static_cast<size_t>(hashes[i]) & mask;
+            while (slots[position].index != 0)
+                position = (position + 1) & mask;
+            slots[position] = {static_cast<uint32_t>(hashes[i] >> 32), static_cast<uint32_t>(i + 1)};
+        }
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ term dictionary ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto TermDictionary::find(std::string_view term, uint64_t hash) const -> long long {
+        const long long* term_id = table.find(term, hash);
+        return term_id ? *term_id : 0;
+    }
+
+    auto TermDictionary::insert(std::string_view term, uint64_t hash, long long term_id) -> void {
+        char* copy = static_cast<char*>(bytes.allocate(std::max<size_t>(term.size(), 1), 1));
+        std::memcpy(copy, term.data(), term.size());
+        bool inserted;
+        table.value(std::string_view(copy, term.size()), hash, inserted) = term_id;
+    }
+
+    auto TermDictionary::clear() -> void {
+        table.clear();
+        bytes.release();
+    }
+}
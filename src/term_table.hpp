@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace indexer {
+
+    // Open-addressing hash table from term bytes to a counter or id, probed linearly over a
+    // flat array of 8-byte slots. Callers pass the term's hash_term value, so every token is
+    // hashed once, and the table never owns the bytes: they must outlive it (or the next
+    // clear()). Entries sit in a dense vector in insertion order, so iterating is a plain scan
+    // and clear() keeps every buffer for the next document.
+    class TermTable {
+    public:
+        using Entry = std::pair<std::string_view, long long>;
+
+        explicit TermTable(size_t capacity = 1024);
+
+        // Value of term, inserted as 0 if missing
+        long long& value(std::string_view term, uint64_t hash, bool& inserted);
+        const long long* find(std::string_view term, uint64_t hash) const;
+        void clear();
+
+        size_t size() const { return items.size(); }
+        bool empty() const { return items.empty(); }
+        const std::vector<Entry>& entries() const { return items; }
+        uint64_t hash(size_t index) const { return hashes[index]; }  // of entries()[index]
+
+    private:
+        struct Slot {
+            uint32_t tag;    // high half of the hash, checked before the bytes
+            uint32_t index;  // entry index + 1, 0 = empty
+        };
+
+        std::vector<Slot> slots;
+        std::vector<uint64_t> hashes;  // parallel to items, for rehashing on growth
+        std::vector<Entry> items;
+        size_t mask;
+
+        size_t probe(std::string_view term, uint64_t hash) const;  // slot holding term, or the empty one to use
+        void grow();
+    };
+
+    // Ingest-side term -> term_id dictionary mirroring the store's terms table. Term bytes are
+    // interned in a monotonic arena, so a new term costs one bump allocation and a lookup none.
+    class TermDictionary {
+    public:
+        TermDictionary() : table(1 << 16) {}
+
+        long long find(std::string_view term, uint64_t hash) const;  // 0 if not cached
+        void insert(std::string_view term, uint64_t hash, long long term_id);
+        void clear();
+        size_t size() const { return table.size(); }
+
+    private:
+        std::pmr::monotonic_buffer_resource bytes {1 << 20};
+        TermTable table;
+    };
+}
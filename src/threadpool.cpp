@@ -1,30 +1,64 @@
+#include <sched.h>
+#include <pthread.h>
+
 #include "threadpool.hpp"
 
 namespace index_stream {
 
-    ThreadPool::ThreadPool(size_t num_threads) : stop(false), pause(false), active_tasks(0) {
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ pin the calling thread to one of the CPUs it may use ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto pin_to_core(size_t slot) -> bool {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+            return false;
+
+        size_t target = slot % static_cast<size_t>(CPU_COUNT(&allowed));
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (!CPU_ISSET(cpu, &allowed) || target-- != 0)
+                continue;
+            cpu_set_t pinned;
+            CPU_ZERO(&pinned);
+            CPU_SET(cpu, &pinned);
+            return pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned) == 0;
+        }
+        return false;
+    }
+
+    ThreadPool::ThreadPool(size_t num_threads, std::array<LaneConfig, LANE_COUNT> lane_configs, bool pin_workers) : active_tasks(0), pause(false), stop(false) {
+        for (size_t i = 0; i < LANE_COUNT; i++)
+            lanes[i].config = lane_configs[i];
+
         for (size_t i = 0; i < num_threads; i++) {
-            this->workers.emplace_back( [this] {
+            this->workers.emplace_back( [this, i, pin_workers] {
+                if (pin_workers)
+                    pin_to_core(i);
                 for(;;) {
-                    std::function<void()> task;
+                    Task task;
+                    size_t lane;
                     {
                         std::unique_lock<std::mutex> lock(this->queue_mutex);
                         this->condition.wait(lock, [this]() { 
-                            return this->stop || (!this->pause && !this->tasks.empty()); 
+                            return (this->stop && this->queued_tasks() == 0) || ((!this->pause || this->stop) && this->runnable()); 
                         });
-                        if (this->stop && this->tasks.empty()) 
+                        if (this->stop && this->queued_tasks() == 0) 
                             return;
-                        if (this->pause) 
-                            continue;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
+                        lane = this->pick_lane();
+                        auto& state = this->lanes[lane];
+                        task = std::move(state.tasks.front());
+                        state.tasks.pop();
+                        state.active++;
+                        state.executed++;
+                        state.max_wait = std::max(state.max_wait, std::chrono::steady_clock::now() - task.queued_at);
                         active_tasks++;  
                     }
-                    task();
+                    task.run();
                     {  
                         std::unique_lock<std::mutex> lock(this->queue_mutex);
                         active_tasks--;
-                        if (active_tasks == 0 && tasks.empty()) {
+                        // A lane at its limit may have been holding back queued work
+                        if (this->lanes[lane].active-- == this->lanes[lane].config.max_active && !this->lanes[lane].tasks.empty())
+                            this->condition.notify_one();
+                        if (active_tasks == 0 && queued_tasks() == 0) {
                             all_tasks_done_condition.notify_one();  
                         }
                     }
@@ -45,6 +79,38 @@ namespace index_stream {
             worker.join();
     }
 
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ any lane with queued work below its concurrency limit (mutex held) ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto ThreadPool::runnable() const -> bool {
+        for (const auto& lane : lanes)
+            if (!lane.tasks.empty() && lane.active < lane.config.max_active)
+                return true;
+        return false;
+    }
+
+    auto ThreadPool::queued_tasks() const -> size_t {
+        size_t queued = 0;
+        for (const auto& lane : lanes)
+            queued += lane.tasks.size();
+        return queued;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ smooth weighted round robin over the runnable lanes (mutex held) ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto ThreadPool::pick_lane() -> size_t {
+        size_t best = LANE_COUNT;
+        long long total = 0;
+        for (size_t i = 0; i < LANE_COUNT; i++) {
+            auto& lane = lanes[i];
+            if (lane.tasks.empty() || lane.active >= lane.config.max_active)
+                continue;
+            lane.current_weight += lane.config.weight;
+            total += lane.config.weight;
+            if (best == LANE_COUNT || lane.current_weight > lanes[best].current_weight)
+                best = i;
+        }
+        lanes[best].current_weight -= total;
+        return best;
+    }
+
     // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Pause the task queue ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
     auto ThreadPool::pause_task_queue() -> void {
         std::unique_lock<std::mutex> lock(queue_mutex);
@@ -69,4 +135,17 @@ namespace index_stream {
         return true;
     }
 
-}
\ No newline at end of file
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ queue depth and throughput of one lane ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 
+    auto ThreadPool::lane_stats(Lane lane) -> LaneStats {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        const auto& state = lanes[static_cast<size_t>(lane)];
+        return LaneStats {
+            state.tasks.size(),
+            state.active,
+            state.config.max_active,
+            state.executed,
+            std::chrono::duration<double, std::milli>(state.max_wait).count()
+        };
+    }
+
+}
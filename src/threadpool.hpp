@@ -5,16 +5,63 @@
 #include <condition_variable>
 #include <functional>
 #include <stdexcept>
+#include <future>
+#include <memory>
+#include <atomic>
+#include <type_traits>
+#include <array>
+#include <chrono>
+#include <cstdint>
 
 
 #ifndef RFSS_THREADPOOL_HPP
 #define RFSS_THREADPOOL_HPP
 
 namespace index_stream {
+
+    // Work classes sharing one pool. Interactive tasks (searches, connection handling) are the
+    // ones a user is waiting on; bulk tasks (ingest bodies, deletes) only need to finish eventually.
+    enum class Lane : size_t { interactive, bulk };
+    constexpr size_t LANE_COUNT = 2;
+
+    // Scheduling share of a lane. When several lanes have runnable tasks, a free worker picks by
+    // smooth weighted round robin, so a lane with weight 8 gets 8 turns for every 1 of a lane
+    // with weight 1. A lane never runs more than max_active tasks at once, whatever its weight.
+    struct LaneConfig {
+        unsigned weight = 1;
+        size_t max_active = SIZE_MAX;
+    };
+
+    struct LaneStats {
+        size_t queued;
+        size_t active;
+        size_t max_active;
+        uint64_t executed;
+        double max_wait_ms;   // longest a task waited in this lane's queue
+    };
+
+    // Pins the calling thread to the slot-th CPU it is allowed to run on (wrapping around).
+    // Returns false if the kernel refused, the thread then keeps running unpinned.
+    bool pin_to_core(size_t slot);
+
     class ThreadPool {
     private:
+        struct Task {
+            std::function<void()> run;
+            std::chrono::steady_clock::time_point queued_at;
+        };
+
+        struct LaneState {
+            LaneConfig config;
+            std::queue<Task> tasks;
+            size_t active {};
+            long long current_weight {};
+            uint64_t executed {};
+            std::chrono::steady_clock::duration max_wait {};
+        };
+
         std::vector<std::thread> workers;
-        std::queue<std::function<void()>> tasks;
+        std::array<LaneState, LANE_COUNT> lanes;
         std::mutex queue_mutex;
         std::condition_variable condition;
         std::condition_variable all_tasks_done_condition;
@@ -22,24 +69,45 @@ namespace index_stream {
         bool pause;
         bool stop;
 
+        bool runnable() const;
+        size_t pick_lane();
+        size_t queued_tasks() const;
+
     public:
-        ThreadPool(size_t num_threads);
+        ThreadPool(size_t num_threads, std::array<LaneConfig, LANE_COUNT> lane_configs = {}, bool pin_workers = false);
         ~ThreadPool();
 
         void pause_task_queue();
         void resume_task_queue();
         bool await_pending_tasks();
+        LaneStats lane_stats(Lane lane);
 
-        template<typename F, typename... Args>
-        auto enqueue(F&& f, Args&&... args) -> void {
+        template<typename F>
+        auto enqueue_to(Lane lane, F&& f) -> void {
             {
                 std::unique_lock<std::mutex> lock(queue_mutex);
                 if (stop)   
                     throw std::runtime_error("enqueue on stopped ThreadPool");
-                tasks.emplace(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+                lanes[static_cast<size_t>(lane)].tasks.push(Task{std::forward<F>(f), std::chrono::steady_clock::now()});
             }
             condition.notify_one();
         }
+
+        template<typename F, typename... Args>
+        auto enqueue(F&& f, Args&&... args) -> void {
+            enqueue_to(Lane::interactive, std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        }
+
+        // Same as enqueue, but hands back a future for the task's result
+        template<typename F>
+        auto submit(F&& f) -> std::future<std::invoke_result_t<F>> {
+            auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(f));
+            auto result = task->get_future();
+            enqueue([task] { (*task)(); });
+            return result;
+        }
+
+        size_t size() const { return workers.size(); }
     };
 }
 
@@ -0,0 +1,83 @@
+#include "tokenizer.hpp"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define INDEXSTREAM_X86 1
+#endif
+
+namespace indexer {
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ scalar kernel, also used for the tail of the SIMD kernels ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    static void normalize_scalar(char* data, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            unsigned char c = static_cast<unsigned char>(data[i]);
+            if (c >= 'A' && c <= 'Z')
+                data[i] = static_cast<char>(c | 0x20);
+            else if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80))
+                data[i] = ' ';
+        }
+    }
+
+#ifdef INDEXSTREAM_X86
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ SSE2 kernel, 16 bytes per step ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    // Bytes are compared as signed, so everything >= 0x80 shows up as negative and is kept as is.
+    static void normalize_sse2(char* data, size_t length) {
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i case_bit = _mm_set1_epi8(0x20);
+        size_t i = 0;
+
+        for (; i + 16 <= length; i += 16) {
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i high = _mm_cmplt_epi8(c, _mm_setzero_si128());
+            __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+            __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('z' + 1)));
+            __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+            __m128i keep = _mm_or_si128(_mm_or_si128(high, upper), _mm_or_si128(lower, digit));
+            __m128i folded = _mm_or_si128(c, _mm_and_si128(upper, case_bit));
+            __m128i out = _mm_or_si128(_mm_and_si128(keep, folded), _mm_andnot_si128(keep, space));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), out);
+        }
+        normalize_scalar(data + i, length - i);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ AVX2 kernel, 32 bytes per step ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    __attribute__((target("avx2")))
+    static void normalize_avx2(char* data, size_t length) {
+        const __m256i space = _mm256_set1_epi8(' ');
+        const __m256i case_bit = _mm256_set1_epi8(0x20);
+        size_t i = 0;
+
+        for (; i + 32 <= length; i += 32) {
+            __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i high = _mm256_cmpgt_epi8(_mm256_setzero_si256(), c);
+            __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), c));
+            __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), c));
+            __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+            __m256i keep = _mm256_or_si256(_mm256_or_si256(high, upper), _mm256_or_si256(lower, digit));
+            __m256i folded = _mm256_or_si256(c, _mm256_and_si256(upper, case_bit));
+            __m256i out = _mm256_blendv_epi8(space, folded, keep);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), out);
+        }
+        normalize_sse2(data + i, length - i);
+    }
+#endif
+
+    using normalize_kernel = void (*)(char*, size_t);
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ pick the widest kernel the CPU supports, once ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    static normalize_kernel select_kernel() {
+#ifdef INDEXSTREAM_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return normalize_avx2;
+        return normalize_sse2;
+#else
+        return normalize_scalar;
+#endif
+    }
+
+    auto normalize_text(char* data, size_t length) -> void {
+        static const normalize_kernel kernel = select_kernel();
+        kernel(data, length);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace indexer {
+
+    // Lowercases ASCII letters and turns every byte that cannot be part of a term into a space,
+    // in place. Term bytes are ASCII letters, digits and anything >= 0x80 (so UTF-8 sequences
+    // survive untouched). The mapping is one byte to one byte, so offsets into the normalized
+    // buffer are offsets into the original text.
+    void normalize_text(char* data, size_t length);
+
+    // Splits normalized text into terms. Tokens are views into the buffer handed in, nothing
+    // is copied or allocated.
+    class Tokenizer {
+    private:
+        std::string_view text;
+        size_t pos {};
+
+    public:
+        explicit Tokenizer(std::string_view normalized) : text(normalized) {}
+
+        bool next(std::string_view& token) {
+            pos = text.find_first_not_of(' ', pos);
+            if (pos == std::string_view::npos)
+                return false;
+
+            size_t end = text.find(' ', pos);
+            if (end == std::string_view::npos)
+                end = text.size();
+
+            token = text.substr(pos, end - pos);
+            pos = end;
+            return true;
+        }
+
+        size_t offset_of(std::string_view token) const {
+            return static_cast<size_t>(token.data() - text.data());
+        }
+    };
+
+    // Normalizes the buffer and hands every term to the callback
+    template<typename F>
+    void for_each_token(char* data, size_t length, F&& f) {
+        normalize_text(data, length);
+        Tokenizer tokens(std::string_view(data, length));
+        std::string_view token;
+        while (tokens.next(token))
+            f(token);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+
+namespace indexer {
+
+    // One bit per document id marking deleted documents. Search takes the read lock once per
+    // query and tests bits without further locking; deletes and compaction take the write lock.
+    class TombstoneBitmap {
+    public:
+        void set(long long doc_id) {
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            size_t word = static_cast<size_t>(doc_id) >> 6;
+            if (word >= bits.size())
+                bits.resize(word + 1, 0);
+            if (!(bits[word] & mask(doc_id))) {
+                bits[word] |= mask(doc_id);
+                count++;
+            }
+        }
+
+        void reset(long long doc_id) {
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            size_t word = static_cast<size_t>(doc_id) >> 6;
+            if (word < bits.size() && (bits[word] & mask(doc_id))) {
+                bits[word] &= ~mask(doc_id);
+                count--;
+            }
+        }
+
+        void clear() {
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            bits.clear();
+            count = 0;
+        }
+
+        bool test(long long doc_id) const {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            return test_unlocked(doc_id);
+        }
+
+        // Caller must hold read_lock()
+        bool test_unlocked(long long doc_id) const {
+            size_t word = static_cast<size_t>(doc_id) >> 6;
+            return word < bits.size() && (bits[word] & mask(doc_id));
+        }
+
+        std::shared_lock<std::shared_mutex> read_lock() const {
+            return std::shared_lock<std::shared_mutex>(mutex);
+        }
+
+        size_t size() const {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            return count;
+        }
+
+    private:
+        mutable std::shared_mutex mutex;
+        std::vector<uint64_t> bits;
+        size_t count {};
+
+        static uint64_t mask(long long doc_id) {
+            return 1ULL << (static_cast<uint64_t>(doc_id) & 63);
+        }
+    };
+}
@@ -0,0 +1,115 @@
+#include <cstdio>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <unistd.h>
+
+#include "trace.hpp"
+#include "config.hpp"
+
+namespace index_stream {
+
+    auto Tracer::get_instance() -> Tracer& {
+        static Tracer instance;
+        return instance;
+    }
+
+    Tracer::Tracer() : origin(std::chrono::steady_clock::now()) {
+        const auto& config = Config::get();
+        path = config.trace_file;
+        on = !path.empty();
+        capacity = static_cast<size_t>(config.trace_buffer_events);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ the calling thread's ring, registered on first use ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    auto Tracer::local() -> ThreadBuffer& {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer) {
+            auto owned = std::make_unique<ThreadBuffer>();
+            owned->ring.resize(capacity);
+            std::lock_guard<std::mutex> lock(buffers_mutex);
+            owned->tid = static_cast<uint32_t>(buffers.size() + 1);
+            buffer = owned.get();
+            buffers.push_back(std::move(owned));
+        }
+        return *buffer;
+    }
+
+    auto Tracer::record(const char* name, const char* category, std::chrono::steady_clock::time_point start,
+                        std::chrono::steady_clock::time_point end, int64_t count) -> void {
+        ThreadBuffer& buffer = local();
+        TraceEvent event {name, category,
+                          std::chrono::duration_cast<std::chrono::microseconds>(start - origin).count(),
+                          std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(), count};
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.ring[buffer.recorded++ % buffer.ring.size()] = event;
+    }
+
+    auto Tracer::name_thread(const char* name) -> void {
+        if (!on)
+            return;
+        ThreadBuffer& buffer = local();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        if (!buffer.name)
+            buffer.name = name;
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ write every buffered span as Chrome trace-event JSON ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    // Complete ("X") events in microseconds, one track per thread named by a metadata event. The
+    // file is written next to its final name and renamed over it, so a viewer never reads half.
+    auto Tracer::export_trace() -> void {
+        if (!on)
+            return;
+        std::lock_guard<std::mutex> export_lock(export_mutex);
+
+        std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        const std::string pid = std::to_string(getpid());
+        bool first = true;
+        auto separator = [&] {
+            if (!first)
+                json += ',';
+            first = false;
+        };
+
+        std::vector<TraceEvent> events;
+        std::lock_guard<std::mutex> buffers_lock(buffers_mutex);
+        for (const auto& buffer : buffers) {
+            const char* thread_name;
+            {
+                std::lock_guard<std::mutex> lock(buffer->mutex);
+                size_t size = buffer->ring.size();
+                size_t kept = static_cast<size_t>(std::min<uint64_t>(buffer->recorded, size));
+                events.clear();
+                for (uint64_t i = buffer->recorded - kept; i < buffer->recorded; i++)
+                    events.push_back(buffer->ring[i % size]);
+                thread_name = buffer->name;
+            }
+
+            const std::string tid = std::to_string(buffer->tid);
+            separator();
+            json.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":").append(pid).append(",\"tid\":").append(tid);
+            json.append(",\"args\":{\"name\":\"").append(thread_name ? thread_name : "thread ").append(thread_name ? "" : tid).append("\"}}");
+            for (const auto& event : events) {
+                separator();
+                json.append("{\"name\":\"").append(event.name).append("\",\"cat\":\"").append(event.category);
+                json.append("\",\"ph\":\"X\",\"ts\":").append(std::to_string(event.start_us));
+                json.append(",\"dur\":").append(std::to_string(event.duration_us));
+                json.append(",\"pid\":").append(pid).append(",\"tid\":").append(tid);
+                if (event.count >= 0)
+                    json.append(",\"args\":{\"count\":").append(std::to_string(event.count)).append("}");
+                json += '}';
+            }
+        }
+        json += "]}\n";
+
+        std::string temp_path = path + ".tmp";
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out || !out.write(json.data(), static_cast<std::streamsize>(json.size()))) {
+            std::cerr << "Failed to write trace file: " << temp_path << std::endl;
+            return;
+        }
+        out.close();
+        if (std::rename(temp_path.c_str(), path.c_str()) != 0)
+            std::cerr << "Failed to move trace file into place: " << path << std::endl;
+    }
+}
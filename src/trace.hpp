@@ -0,0 +1,88 @@
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef RFSS_TRACE_HPP
+#define RFSS_TRACE_HPP
+
+namespace index_stream {
+
+    // One finished span. Names and categories are string literals, so recording never allocates.
+    struct TraceEvent {
+        const char* name;
+        const char* category;
+        int64_t start_us;     // since the tracer started
+        int64_t duration_us;
+        int64_t count;        // exported as args.count, -1 = none
+    };
+
+    // Ingest spans for chrome://tracing or Perfetto. Every thread records into a fixed ring of its
+    // own, so a span costs two clock reads and one uncontended lock; once a ring is full the oldest
+    // spans are overwritten. export_trace() rewrites INDEXSTREAM_TRACE_FILE with everything the
+    // rings hold, as Chrome trace-event JSON. With no trace file configured, spans record nothing.
+    class Tracer {
+    public:
+        static Tracer& get_instance();
+        Tracer(const Tracer&) = delete;
+        Tracer& operator=(const Tracer&) = delete;
+
+        bool enabled() const { return on; }
+        void record(const char* name, const char* category, std::chrono::steady_clock::time_point start,
+                    std::chrono::steady_clock::time_point end, int64_t count);
+        void name_thread(const char* name);  // track name of the calling thread, first call wins
+        void export_trace();
+
+    private:
+        struct ThreadBuffer {
+            std::mutex mutex;
+            std::vector<TraceEvent> ring;
+            uint64_t recorded {};  // ever, the next slot is recorded % ring size
+            uint32_t tid {};
+            const char* name {};
+        };
+
+        bool on {};
+        size_t capacity {};
+        std::string path;
+        std::chrono::steady_clock::time_point origin;
+        std::mutex buffers_mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;  // never shrinks, threads keep a pointer
+        std::mutex export_mutex;
+
+        Tracer();
+        ThreadBuffer& local();
+    };
+
+    // Times the enclosing scope as one span
+    class TraceSpan {
+    public:
+        explicit TraceSpan(const char* name, const char* category = "ingest") : name(name), category(category) {
+            if (Tracer::get_instance().enabled()) {
+                active = true;
+                start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~TraceSpan() {
+            if (active)
+                Tracer::get_instance().record(name, category, start, std::chrono::steady_clock::now(), count);
+        }
+
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+
+        void set_count(int64_t value) { count = value; }
+
+    private:
+        const char* name;
+        const char* category;
+        bool active {};
+        int64_t count {-1};
+        std::chrono::steady_clock::time_point start;
+    };
+}
+
+#endif